@@ -0,0 +1,66 @@
+// Benchmark: scaling of parallel code generation (-j) from 1 to 32 threads.
+// Compiles a program from the shared generator to an object file at -O2,
+// which exercises code generation, optimization and the backend. The
+// threads' modules are merged and given the post-link passes before the
+// object is written, which runs on one thread.
+//
+//   codegen_bench [functions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "deviant_llvm.h"
+#include "program_generator.h"
+
+namespace {
+
+// best of a few runs, in milliseconds
+double measure(const std::string& program, unsigned jobs) {
+  deviant::CompileOptions options;
+  options.opt_level = deviant::OptLevel::O2;
+  options.emit = deviant::Emit::OBJ;
+  options.output = "codegen_bench.o";
+  options.jobs = jobs;
+
+  double best = 0;
+  for (int run = 0; run < 3; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    deviant::DeviantLLVM vm(options);
+    if (vm.execute(program) != EXIT_SUCCESS || !vm.finish()) {
+      std::fprintf(stderr, "compilation failed\n");
+      std::exit(EXIT_FAILURE);
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    if (run == 0 || ms < best) {
+      best = ms;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  deviant::GeneratorOptions generator;
+  generator.functions = argc > 1 ? std::atoi(argv[1]) : 4000;
+  generator.exported = true;
+  const std::string program = deviant::generateProgram(generator);
+
+  std::printf("%d functions, %zu bytes of source, -O2 object output\n",
+              generator.functions, program.size());
+  std::printf("%8s %12s %9s\n", "threads", "ms", "speedup");
+  double serial = 0;
+  for (unsigned jobs : {1u, 2u, 4u, 8u, 16u, 32u}) {
+    double ms = measure(program, jobs);
+    if (jobs == 1) {
+      serial = ms;
+    }
+    std::printf("%8u %12.1f %8.2fx\n", jobs, ms, serial / ms);
+  }
+  std::remove("codegen_bench.o");
+  return 0;
+}
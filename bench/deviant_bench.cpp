@@ -0,0 +1,186 @@
+// Throughput of the compiler stages on a synthetic program: lexing
+// (Lexer::tokenize), parsing (Parser::parse), IR generation
+// (Program::generateCode) and module emission (bitcode and textual IR).
+// Every stage is timed on its own and reported as the median of a few runs.
+//
+//   deviant_bench [-n functions] [-d depth] [-l identifier length]
+//                 [-c comment lines] [-a arithmetic terms] [-r runs]
+//                 [-w program.dv]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "arena.h"
+#include "deviant_llvm.h"
+#include "interner.h"
+#include "lexer.h"
+#include "parser.h"
+#include "program_generator.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// median seconds of runs calls of step; setup runs before each call and is
+// not timed
+double median(int runs, const std::function<void()>& setup,
+              const std::function<void()>& step) {
+  std::vector<double> seconds;
+  for (int run = 0; run < runs; ++run) {
+    setup();
+    auto start = Clock::now();
+    step();
+    seconds.push_back(
+        std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  std::sort(seconds.begin(), seconds.end());
+  return seconds[seconds.size() / 2];
+}
+
+void report(const char* stage, double seconds, double items,
+            const char* unit) {
+  std::printf("%-12s %10.3f ms %14.0f %s/s\n", stage, seconds * 1000,
+              items / seconds, unit);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  deviant::GeneratorOptions options;
+  int runs = 5;
+  const char* write = nullptr;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const int value = std::atoi(argv[i + 1]);
+    if (std::strcmp(argv[i], "-n") == 0) {
+      options.functions = value;
+    } else if (std::strcmp(argv[i], "-d") == 0) {
+      options.depth = value;
+    } else if (std::strcmp(argv[i], "-l") == 0) {
+      options.identifier_length = value;
+    } else if (std::strcmp(argv[i], "-c") == 0) {
+      options.comment_lines = value;
+    } else if (std::strcmp(argv[i], "-a") == 0) {
+      options.arithmetic_terms = value;
+    } else if (std::strcmp(argv[i], "-r") == 0) {
+      runs = std::max(1, value);
+    } else if (std::strcmp(argv[i], "-w") == 0) {
+      write = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const std::string program = deviant::generateProgram(options);
+  if (write) {
+    std::ofstream(write, std::ios::binary) << program;
+  }
+  const double functions = options.functions + 1;  // and main
+  std::printf(
+      "%d functions, depth %d, %d-character identifiers, %d comment lines, "
+      "%d arithmetic terms: %zu bytes, median of %d runs\n",
+      options.functions, options.depth, options.identifier_length,
+      options.comment_lines, options.arithmetic_terms, program.size(), runs);
+
+  // lexing
+  size_t tokens = 0;
+  {
+    std::unique_ptr<deviant::Interner> interner;
+    std::unique_ptr<deviant::Lexer> lexer;
+    double seconds = median(
+        runs,
+        [&] {
+          lexer.reset();
+          interner = std::make_unique<deviant::Interner>();
+          lexer = std::make_unique<deviant::Lexer>(program, *interner);
+        },
+        [&] { lexer->tokenize(); });
+    tokens = lexer->size();
+    report("lex", seconds, tokens, "tokens");
+  }
+
+  // parsing, which pulls its tokens from the lexer as it goes
+  size_t nodes = 0;
+  {
+    std::unique_ptr<deviant::Interner> interner;
+    std::unique_ptr<deviant::Arena> arena;
+    std::unique_ptr<deviant::Parser> parser;
+    double seconds = median(
+        runs,
+        [&] {
+          parser.reset();
+          interner = std::make_unique<deviant::Interner>();
+          arena = std::make_unique<deviant::Arena>();
+          parser =
+              std::make_unique<deviant::Parser>(program, *arena, *interner);
+        },
+        [&] { parser->parse(); });
+    nodes = arena->objects();
+    report("parse", seconds, nodes, "nodes");
+    report("", seconds, tokens, "tokens");
+  }
+
+  // IR generation and emission, on a fresh module every run
+  std::unique_ptr<deviant::DeviantLLVM> vm;
+  deviant::Program* ast = nullptr;
+  auto fresh = [&] {
+    vm = std::make_unique<deviant::DeviantLLVM>();
+    ast = vm->parse(program);
+  };
+  auto compiled = [&] {
+    fresh();
+    vm->compile(*ast);
+  };
+
+  double seconds = median(runs, fresh, [&] { vm->compile(*ast); });
+  const double instructions = vm->getModule()->getInstructionCount();
+  report("codegen", seconds, functions, "functions");
+  report("", seconds, instructions, "instructions");
+
+  llvm::SmallVector<char, 0> buffer;
+  seconds = median(
+      runs,
+      [&] {
+        compiled();
+        buffer.clear();
+      },
+      [&] {
+        llvm::raw_svector_ostream os(buffer);
+        llvm::WriteBitcodeToFile(*vm->getModule(), os);
+      });
+  report("emit bc", seconds, functions, "functions");
+  report("", seconds, buffer.size(), "bytes");
+
+  seconds = median(
+      runs,
+      [&] {
+        compiled();
+        buffer.clear();
+      },
+      [&] {
+        llvm::raw_svector_ostream os(buffer);
+        vm->getModule()->print(os, nullptr);
+      });
+  report("emit ll", seconds, functions, "functions");
+  report("", seconds, buffer.size(), "bytes");
+  return EXIT_SUCCESS;
+}
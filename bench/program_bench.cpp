@@ -0,0 +1,402 @@
+// Benchmark: run time of compiled Deviant programs. Every program of
+// bench/programs (or the ones given) is compiled by the deviant executable
+// at each optimization level, then run a few times in each execution mode:
+//
+//   exe  built with -o and run as its own process
+//   jit  `deviant run`; wall time and instructions include JIT compilation,
+//        run_ms is main() alone as reported by -v
+//
+// The median wall time and, where perf_event_open allows it, instructions
+// retired in user space are written as JSON, and compared against a
+// baseline written by an earlier run.
+//
+//   program_bench [-r runs] [-o results.json] [-b baseline.json]
+//                 [-t percent] [program.dv ...]
+//
+// With -b the exit status is 1 if a result got slower than the baseline by
+// more than -t percent (default 10); instructions are compared where both
+// sides have them, as they are far less noisy than wall time.
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace {
+
+const char* const kOptLevels[] = {"-O0", "-O1", "-O2", "-O3", "-Os"};
+
+struct Sample {
+  double wall_ms;
+  double run_ms;                        // -1 unless reported by the program
+  std::optional<uint64_t> instructions;  // unless counters are unavailable
+  int status;
+};
+
+struct Result {
+  std::string program;
+  std::string opt;
+  std::string mode;
+  double median_ms;
+  double run_ms;
+  std::optional<uint64_t> instructions;
+  int status;
+};
+
+// instructions retired in user space by pid and its children, counting
+// from PERF_EVENT_IOC_ENABLE; -1 where the kernel or the VM has no counters
+int openInstructionCounter(pid_t pid) {
+#if defined(__linux__)
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+
+// run argv with stdout discarded and return what it cost; stderr is
+// collected into err
+Sample spawn(const std::vector<std::string>& argv, std::string& err) {
+  std::vector<char*> args;
+  for (const std::string& arg : argv) {
+    args.push_back(const_cast<char*>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+
+  // the child waits on go until its counter is enabled
+  int go[2], errors[2];
+  if (pipe(go) != 0 || pipe(errors) != 0) {
+    std::perror("pipe");
+    std::exit(EXIT_FAILURE);
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(go[1]);
+    close(errors[0]);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(errors[1], STDERR_FILENO);
+    char byte;
+    if (read(go[0], &byte, 1) != 1)
+      _exit(127);
+    execv(args[0], args.data());
+    _exit(127);
+  }
+  close(go[0]);
+  close(errors[1]);
+
+  int counter = openInstructionCounter(pid);
+  auto start = std::chrono::steady_clock::now();
+#if defined(__linux__)
+  if (counter >= 0) {
+    ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+  (void)!write(go[1], "x", 1);
+  close(go[1]);
+
+  err.clear();
+  char buffer[4096];
+  ssize_t size;
+  while ((size = read(errors[0], buffer, sizeof(buffer))) > 0) {
+    err.append(buffer, size);
+  }
+  close(errors[0]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  Sample sample;
+  sample.wall_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  sample.run_ms = -1;
+  sample.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  if (counter >= 0) {
+    uint64_t count;
+    if (read(counter, &count, sizeof(count)) == sizeof(count)) {
+      sample.instructions = count;
+    }
+    close(counter);
+  }
+  return sample;
+}
+
+// "jit: 1.234 ms compiling, 5.678 ms running" of deviant run -v
+double jitRunMilliseconds(const std::string& err) {
+  size_t line = err.find("jit: ");
+  if (line == std::string::npos)
+    return -1;
+  double compile_ms, run_ms;
+  if (std::sscanf(err.c_str() + line, "jit: %lf ms compiling, %lf ms running",
+                  &compile_ms, &run_ms) != 2)
+    return -1;
+  return run_ms;
+}
+
+template <typename T>
+T median(std::vector<T> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+Result measure(const std::string& program, const std::string& opt,
+               const std::string& mode, const std::vector<std::string>& argv,
+               int runs) {
+  std::vector<double> wall, run;
+  std::vector<uint64_t> instructions;
+  Result result{llvm::sys::path::stem(program).str(), opt.substr(1), mode, 0,
+                -1, std::nullopt, 0};
+  std::string err;
+  for (int i = 0; i < runs; ++i) {
+    Sample sample = spawn(argv, err);
+    wall.push_back(sample.wall_ms);
+    if (sample.instructions) {
+      instructions.push_back(*sample.instructions);
+    }
+    double run_ms = jitRunMilliseconds(err);
+    if (run_ms >= 0) {
+      run.push_back(run_ms);
+    }
+    result.status = sample.status;
+  }
+  result.median_ms = median(wall);
+  if (!run.empty()) {
+    result.run_ms = median(run);
+  }
+  if (instructions.size() == wall.size()) {
+    result.instructions = median(instructions);
+  }
+  return result;
+}
+
+llvm::json::Value toJSON(const std::vector<Result>& results, int runs) {
+  llvm::json::Array array;
+  for (const Result& result : results) {
+    llvm::json::Object object{{"program", result.program},
+                              {"opt", result.opt},
+                              {"mode", result.mode},
+                              {"median_ms", result.median_ms},
+                              {"status", result.status}};
+    if (result.run_ms >= 0) {
+      object["run_ms"] = result.run_ms;
+    }
+    object["instructions"] =
+        result.instructions ? llvm::json::Value(int64_t(*result.instructions))
+                            : llvm::json::Value(nullptr);
+    array.push_back(std::move(object));
+  }
+  return llvm::json::Object{{"runs", runs}, {"results", std::move(array)}};
+}
+
+// print the change of every result against the baseline; false if any got
+// slower by more than threshold percent
+bool compare(const std::vector<Result>& results, const std::string& filename,
+             double threshold) {
+  auto buffer = llvm::MemoryBuffer::getFile(filename);
+  if (!buffer) {
+    std::fprintf(stderr, "cannot read %s\n", filename.c_str());
+    return false;
+  }
+  auto baseline = llvm::json::parse((*buffer)->getBuffer());
+  const llvm::json::Array* entries = nullptr;
+  if (baseline) {
+    if (const llvm::json::Object* root = baseline->getAsObject())
+      entries = root->getArray("results");
+  } else {
+    llvm::consumeError(baseline.takeError());
+  }
+  if (!entries) {
+    std::fprintf(stderr, "%s is not a program_bench result\n",
+                 filename.c_str());
+    return false;
+  }
+
+  bool ok = true;
+  std::printf("\n%-16s %-3s %-4s %12s %10s\n", "vs baseline", "opt", "mode",
+              "time", "instr");
+  for (const Result& result : results) {
+    const llvm::json::Object* base = nullptr;
+    for (const llvm::json::Value& entry : *entries) {
+      const llvm::json::Object* object = entry.getAsObject();
+      auto is = [&](llvm::StringRef key, const std::string& value) {
+        auto text = object->getString(key);
+        return text && *text == value;
+      };
+      if (object && is("program", result.program) && is("opt", result.opt) &&
+          is("mode", result.mode)) {
+        base = object;
+        break;
+      }
+    }
+    if (!base) {
+      std::printf("%-16s %-3s %-4s %12s\n", result.program.c_str(),
+                  result.opt.c_str(), result.mode.c_str(), "new");
+      continue;
+    }
+
+    auto change = [](double now, double before) {
+      return before > 0 ? 100.0 * (now - before) / before : 0.0;
+    };
+    auto before_ms = base->getNumber("median_ms");
+    const double time = change(result.median_ms, before_ms ? *before_ms : 0);
+    std::optional<double> instructions;
+    if (auto before = base->getInteger("instructions");
+        before && result.instructions) {
+      instructions = change(double(*result.instructions), double(*before));
+    }
+
+    const double regression = instructions ? *instructions : time;
+    const bool slower = regression > threshold;
+    ok = ok && !slower;
+    std::printf("%-16s %-3s %-4s %+11.1f%%", result.program.c_str(),
+                result.opt.c_str(), result.mode.c_str(), time);
+    if (instructions) {
+      std::printf(" %+9.1f%%", *instructions);
+    } else {
+      std::printf(" %10s", "-");
+    }
+    std::printf(slower ? "  slower\n" : "\n");
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int runs = 5;
+  double threshold = 10;
+  std::string output, baseline;
+  std::vector<std::string> programs;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "-r" && has_value) {
+      runs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "-o" && has_value) {
+      output = argv[++i];
+    } else if (arg == "-b" && has_value) {
+      baseline = argv[++i];
+    } else if (arg == "-t" && has_value) {
+      threshold = std::atof(argv[++i]);
+    } else if (arg[0] != '-') {
+      programs.push_back(arg);
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (programs.empty()) {
+    std::error_code err_code;
+    for (llvm::sys::fs::directory_iterator it(DEVIANT_BENCH_PROGRAMS,
+                                              err_code),
+         end;
+         it != end && !err_code; it.increment(err_code)) {
+      if (llvm::sys::path::extension(it->path()) == ".dv")
+        programs.push_back(it->path());
+    }
+    std::sort(programs.begin(), programs.end());
+  }
+
+  llvm::SmallString<128> dir;
+  if (llvm::sys::fs::createUniqueDirectory("program_bench", dir)) {
+    std::fprintf(stderr, "cannot create a temporary directory\n");
+    return EXIT_FAILURE;
+  }
+
+  const std::string deviant = DEVIANT_EXECUTABLE;
+  std::vector<Result> results;
+  std::string err;
+  std::printf("%-16s %-3s %-4s %12s %12s %14s\n", "program", "opt", "mode",
+              "median ms", "run ms", "instructions");
+  for (const std::string& program : programs) {
+    for (const char* opt : kOptLevels) {
+      llvm::SmallString<128> exe(dir);
+      llvm::sys::path::append(exe, llvm::sys::path::stem(program) + opt);
+      Sample build = spawn({deviant, program, opt, "-o", exe.str().str()}, err);
+      if (build.status != 0) {
+        std::fprintf(stderr, "%s %s does not compile:\n%s", program.c_str(),
+                     opt, err.c_str());
+        continue;
+      }
+
+      results.push_back(
+          measure(program, opt, "exe", {exe.str().str()}, runs));
+      results.push_back(measure(program, opt, "jit",
+                                {deviant, "run", program, opt, "-v"}, runs));
+      llvm::sys::fs::remove(exe);
+
+      for (auto it = results.end() - 2; it != results.end(); ++it) {
+        std::printf("%-16s %-3s %-4s %12.3f ", it->program.c_str(),
+                    it->opt.c_str(), it->mode.c_str(), it->median_ms);
+        if (it->run_ms >= 0) {
+          std::printf("%12.3f ", it->run_ms);
+        } else {
+          std::printf("%12s ", "-");
+        }
+        if (it->instructions) {
+          std::printf("%14llu",
+                      static_cast<unsigned long long>(*it->instructions));
+        } else {
+          std::printf("%14s", "-");
+        }
+        std::printf("\n");
+      }
+    }
+  }
+  llvm::sys::fs::remove(dir);
+
+  if (!output.empty()) {
+    std::error_code err_code;
+    llvm::raw_fd_ostream out(output, err_code);
+    if (err_code) {
+      std::fprintf(stderr, "cannot write %s\n", output.c_str());
+      return EXIT_FAILURE;
+    }
+    out << llvm::formatv("{0:2}", toJSON(results, runs)) << "\n";
+  }
+  if (!baseline.empty() && !compare(results, baseline, threshold))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+#include "program_generator.h"
+
+namespace deviant {
+namespace {
+
+// v<i>x padded with a run of letters to length characters
+std::string variable(int i, int length) {
+  std::string name = "v" + std::to_string(i) + "x";
+  while (static_cast<int>(name.size()) < length) {
+    name += static_cast<char>('a' + name.size() % 26);
+  }
+  return name;
+}
+
+void indent(std::string& out, int level) { out.append(2 * level, ' '); }
+
+// statements at one nesting level; recurses for the nested if
+void appendBody(std::string& out, const GeneratorOptions& options, int fn,
+                int level) {
+  const std::string a = variable(2 * level, options.identifier_length);
+  const std::string b = variable(2 * level + 1, options.identifier_length);
+  const std::string callee = "f" + std::to_string(fn > 0 ? fn - 1 : 0);
+
+  std::string terms;
+  for (int t = 1; t <= options.arithmetic_terms; ++t) {
+    terms += (t % 2 ? " + " : " - ") + std::to_string(t) + " * " +
+             std::to_string(t + 1);
+  }
+
+  indent(out, level + 1);
+  out += "var " + a + " = " + std::to_string(fn) + terms + ";\n";
+  indent(out, level + 1);
+  out += "var " + b + " = " + std::to_string(level) + terms + ";\n";
+  indent(out, level + 1);
+  out += b + " = " + callee + "();\n";
+  indent(out, level + 1);
+  out += "print(" + b + ");\n";
+
+  if (level < options.depth) {
+    indent(out, level + 1);
+    out += "if (" + a + ") {\n";
+    appendBody(out, options, fn, level + 1);
+    indent(out, level + 1);
+    out += "}\n";
+  }
+}
+
+}  // namespace
+
+std::string generateProgram(const GeneratorOptions& options) {
+  std::string out;
+  for (int fn = 0; fn < options.functions; ++fn) {
+    for (int c = 0; c < options.comment_lines; ++c) {
+      out += "// f" + std::to_string(fn) +
+             ": generated benchmark function, this comment line is only "
+             "here to give the lexer something to skip\n";
+    }
+    out += options.exported ? "export fn f" : "fn f";
+    out += std::to_string(fn) + "() -> int {\n";
+    appendBody(out, options, fn, 0);
+    out += "  ret " + variable(0, options.identifier_length) + ";\n}\n\n";
+  }
+  out += "fn main() -> int {\n  ret 0;\n}\n";
+  return out;
+}
+
+}  // namespace deviant
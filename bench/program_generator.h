@@ -0,0 +1,39 @@
+#ifndef __PROGRAM_GENERATOR_H__
+#define __PROGRAM_GENERATOR_H__
+
+#include <string>
+
+namespace deviant {
+
+// Shape of a synthetic Deviant program for the benchmarks.
+struct GeneratorOptions {
+  int functions{1000};
+
+  // if statements nested inside each function body
+  int depth{2};
+
+  // length of every variable name
+  int identifier_length{16};
+
+  // comment lines in front of every function
+  int comment_lines{2};
+
+  // literal terms like "+ 3 * 4" appended to every variable initializer,
+  // which the parser folds away
+  int arithmetic_terms{0};
+
+  // mark f0..fN-1 export; main calls none of them, so an optimizing
+  // compile would otherwise delete them all
+  bool exported{false};
+};
+
+// A program of options.functions functions f0..fN-1 plus main. Every
+// function declares a few long-named variables, calls its predecessor and
+// print, and nests options.depth if statements doing the same. The output
+// only uses constructs the parser already handles, so it can be fed to
+// the deviant executable as well.
+std::string generateProgram(const GeneratorOptions& options);
+
+}  // namespace deviant
+
+#endif  // __PROGRAM_GENERATOR_H__
@@ -0,0 +1,81 @@
+// Micro-benchmark: cost of a variable lookup against scope nesting depth,
+// for the flat ScopeTable used by DeviantLLVM and for the previous scheme of
+// one std::map per scope searched from the innermost scope outwards.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "scope_table.h"
+
+namespace {
+
+using deviant::ScopeTable;
+using deviant::Symbol;
+
+constexpr int kLookups = 1 << 22;
+
+// one std::map per scope, as CodeGenBlock used to keep
+class MapChain {
+ public:
+  void enterScope() { scopes_.emplace_back(); }
+  void exitScope() { scopes_.pop_back(); }
+  void bind(Symbol symbol, int* value) { scopes_.back()[symbol] = value; }
+  int* find(Symbol symbol) {
+    for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+      if (it->find(symbol) != it->end()) {
+        return (*it)[symbol];
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  std::vector<std::map<Symbol, int*>> scopes_;
+};
+
+// nest depth scopes with a few variables each, then look up a variable of
+// the outermost scope; returns nanoseconds per lookup
+template <typename Scopes>
+double measure(int depth) {
+  constexpr int kVarsPerScope = 4;
+  std::vector<int> values(depth * kVarsPerScope);
+
+  Scopes scopes;
+  Symbol next = 0;
+  for (int d = 0; d < depth; ++d) {
+    scopes.enterScope();
+    for (int v = 0; v < kVarsPerScope; ++v, ++next) {
+      scopes.bind(next, &values[next]);
+    }
+  }
+
+  const Symbol outermost = 0;
+  int* volatile sink = nullptr;  // keeps the lookups alive
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kLookups; ++i) {
+    sink = scopes.find(outermost + (i & (kVarsPerScope - 1)));
+  }
+  auto end = std::chrono::steady_clock::now();
+  if (sink == nullptr)  // every symbol looked up is bound
+    std::abort();
+
+  for (int d = 0; d < depth; ++d) {
+    scopes.exitScope();
+  }
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         kLookups;
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%8s %16s %16s\n", "depth", "flat ns/lookup", "chain ns/lookup");
+  for (int depth = 1; depth <= 1024; depth *= 2) {
+    std::printf("%8d %16.2f %16.2f\n", depth, measure<ScopeTable<int>>(depth),
+                measure<MapChain>(depth));
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace deviant {
+
+// Bump allocator that lives for one compilation. Objects are carved out of
+// large blocks and the whole arena is released at once in ~Arena(); the
+// destructors of objects built with make() are never run, so they must not
+// own memory outside the arena. As a std::pmr::memory_resource it also backs
+// the std::pmr containers held by such objects.
+class Arena : public std::pmr::memory_resource {
+ public:
+  explicit Arena(size_t block_size = 64 * 1024) : block_size_(block_size) {}
+  ~Arena() override;
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    ++objects_;
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // number of objects built with make()
+  size_t objects() const { return objects_; }
+
+  // bytes handed out, including container storage
+  size_t bytesUsed() const { return bytes_used_; }
+
+  // bytes obtained from the system
+  size_t bytesReserved() const { return bytes_reserved_; }
+
+  size_t blocks() const { return blocks_.size(); }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur_) + alignment - 1) &
+                  ~(uintptr_t(alignment) - 1);
+    if (cur_ == nullptr || p + bytes > reinterpret_cast<uintptr_t>(end_)) {
+      return grow(bytes, alignment);
+    }
+    cur_ = reinterpret_cast<char*>(p + bytes);
+    bytes_used_ += bytes;
+    return reinterpret_cast<void*>(p);
+  }
+
+  // memory is only returned when the arena goes away
+  void do_deallocate(void*, size_t, size_t) override {}
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  // start a new block big enough for the request
+  void* grow(size_t bytes, size_t alignment);
+
+  size_t block_size_;
+  char* cur_{nullptr};
+  char* end_{nullptr};
+  std::vector<char*> blocks_;
+
+  size_t objects_{0};
+  size_t bytes_used_{0};
+  size_t bytes_reserved_{0};
+};
+
+}  // namespace deviant
+
+#endif  // __ARENA_H__
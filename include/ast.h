@@ -1,8 +1,10 @@
 #ifndef __AST__
 #define __AST__
 
-#include <memory>
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #if defined(_MSC_VER)
@@ -15,10 +17,18 @@
 #pragma warning(pop)
 #endif
 
+#include "arena.h"
+#include "interner.h"
+
 namespace deviant {
 
+class AstHasher;
 class DeviantLLVM;
 
+// types a value can be spelled with; the vector types map to LLVM vectors
+// of 32-bit lanes, operated on lane by lane
+enum class ValueType : uint8_t { INT, FLOAT, I32X4, I32X8, F32X8 };
+
 class AstNode {
  public:
   enum class Type {
@@ -28,8 +38,19 @@ class AstNode {
     INTEGER,
     DECIMAL,
     BOOLEAN,
-    IDENTIFIER
+    IDENTIFIER,
+    FUNCTION,
+    CALL,
+    ARITHMETIC,
+    NEGATION,
+    COMPARISON,
+    CONDITIONAL,
+    LOOP,
+    ARRAY
   };
+  // Nodes are built in an Arena and never destroyed individually: children
+  // are plain pointers into the same arena, child lists are std::pmr
+  // containers on it and names are interned Symbols.
   virtual ~AstNode() = default;
 
   // TODO: pure virtual
@@ -38,12 +59,19 @@ class AstNode {
   virtual Type type() = 0;
 
   virtual std::string toString() = 0;
+
+  // feed the node and its children into a content hash
+  virtual void hash(AstHasher& hasher);
 };
 
 class Expression : public AstNode {
  public:
   ~Expression() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override = 0;
+
+  // the value as the i1 a branch needs, value != 0 unless the node can
+  // produce an i1 directly
+  virtual llvm::Value* generateCondition(DeviantLLVM& context);
   Type type() override { return Type::EXPRESSTION; }
   std::string toString() override { return "Expression"; }
 };
@@ -58,17 +86,27 @@ class Statement : public Expression {
 
 class Program : public AstNode {
  public:
+  explicit Program(Arena& arena) : statements_(&arena) {}
   ~Program() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override;
   Type type() override { return Type::PROGRAM; }
   std::string toString() override { return "Program"; }
 
-  void pushBack(std::unique_ptr<Statement>&& statement) {
-    statements_.emplace_back(std::move(statement));
-  }
+  // generate only statements [first, last); parallel and cached code
+  // generation hand each worker one such slice
+  llvm::Value* generateCode(DeviantLLVM& context, size_t first, size_t last);
+
+  // create the prototypes of all functions
+  void declare(DeviantLLVM& context);
+
+  void pushBack(Statement* statement) { statements_.push_back(statement); }
+
+  size_t size() const { return statements_.size(); }
+
+  Statement* statement(size_t i) const { return statements_[i]; }
 
  private:
-  std::vector<std::unique_ptr<Statement>> statements_;
+  std::pmr::vector<Statement*> statements_;
 };
 
 class Integer : public Expression {
@@ -76,46 +114,62 @@ class Integer : public Expression {
   explicit Integer(int value) : value_(value) {}
   ~Integer() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   Type type() override { return Type::INTEGER; }
   std::string toString() override { return " "; }
 
+  int getValue() const { return value_; }
+
  private:
   int value_;
 };
 
+// A float literal like 1.5, single precision.
+class Decimal : public Expression {
+ public:
+  explicit Decimal(float value) : value_(value) {}
+  ~Decimal() override = default;
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::DECIMAL; }
+  std::string toString() override { return " "; }
+
+  float getValue() const { return value_; }
+
+ private:
+  float value_;
+};
+
 class Identifier : public Expression {
  public:
-  explicit Identifier(const std::string& name) : name_(name) {}
+  explicit Identifier(Symbol name) : name_(name) {}
   ~Identifier() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   Type type() override { return Type::IDENTIFIER; }
   std::string toString() override { return "identifier"; }
 
-  const std::string& getName() { return name_; }
+  Symbol getName() { return name_; }
 
  private:
-  std::string name_;
+  Symbol name_;
 };
 
 class VariableDeclaration : public Statement {
  public:
-  VariableDeclaration(std::unique_ptr<Identifier>&& identifier,
-                      std::unique_ptr<Expression>&& expr)
-      : identifier_(std::move(identifier)), expr_(std::move(expr)) {}
+  VariableDeclaration(Identifier* identifier, Expression* expr)
+      : identifier_(identifier), expr_(expr) {}
   ~VariableDeclaration() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   Type type() override { return Type::STATEMENT; }
   std::string toString() override { return "let"; }
-  void setIdentifier(std::unique_ptr<Identifier>&& identifier) {
-    identifier_ = std::move(identifier);
-  }
-  void setExpression(std::unique_ptr<Expression>&& expr) {
-    expr_ = std::move(expr_);
-  }
+  void setIdentifier(Identifier* identifier) { identifier_ = identifier; }
+  void setExpression(Expression* expr) { expr_ = expr; }
 
  private:
-  std::unique_ptr<Identifier> identifier_;
-  std::unique_ptr<Expression> expr_;
+  Identifier* identifier_;
+  Expression* expr_;
 };
 
 class Assignment : public Statement {
@@ -123,122 +177,329 @@ class Assignment : public Statement {
   explicit Assignment() {}
   ~Assignment() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   Type type() override { return Type::STATEMENT; }
   std::string toString() override { return "var"; }
-  void setVarname(const std::string& name) { var_name_ = name; }
-  void setExpression(std::unique_ptr<Expression>&& expr) {
-    expr_ = std::move(expr);
-  }
+  void setVarname(Symbol name) { var_name_ = name; }
+  void setExpression(Expression* expr) { expr_ = expr; }
+  // assign to var_name[index], an array element or a vector lane
+  void setIndex(Expression* index) { index_ = index; }
+
+ private:
+  // Identifier* identifier_;
+  Symbol var_name_{kNoSymbol};
+  Expression* expr_{nullptr};
+  Expression* index_{nullptr};
+};
+
+// var name[length]; or var name[length] = [values];, the elements after
+// the values zero. The element type is that of the first value, int
+// without any. Global arrays are module globals, so their values must be
+// literals; local ones live in a stack slot of the function.
+class ArrayDeclaration : public Statement {
+ public:
+  ArrayDeclaration(Symbol name, uint32_t length, bool global, Arena& arena)
+      : name_(name), length_(length), global_(global), values_(&arena) {}
+  ~ArrayDeclaration() override = default;
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::ARRAY; }
+  std::string toString() override { return "array"; }
+  // declare a global array in the module
+  void declare(DeviantLLVM& context);
+
+  void addValue(Expression* value) { values_.push_back(value); }
+  Symbol getName() const { return name_; }
+  uint32_t getLength() const { return length_; }
+  bool isGlobal() const { return global_; }
 
  private:
-  // std::unique_ptr<Identifier> identifier_;
-  std::string var_name_;
-  std::unique_ptr<Expression> expr_;
+  llvm::Type* elementType(DeviantLLVM& context);
+
+  Symbol name_;
+  uint32_t length_;
+  bool global_;
+  std::pmr::vector<Expression*> values_;
 };
 
 class Block : public Expression {
  public:
+  explicit Block(Arena& arena) : statements_(&arena) {}
   ~Block() override = default;
 
   Type type() override { return Type::EXPRESSTION; }
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   std::string toString() override { return "block"; }
-  void insertStatement(std::unique_ptr<Statement>&& stmt) {
-    statements_.push_back(std::move(stmt));
-  }
+  void insertStatement(Statement* stmt) { statements_.push_back(stmt); }
 
  private:
-  std::vector<std::unique_ptr<Statement>> statements_;
+  std::pmr::vector<Statement*> statements_;
 };
 
+// ret value; and ret tail f(...);, a call that reuses the frame of the
+// caller, so recursion through it runs in constant stack space. That is
+// only possible between functions with the same parameter and return types
+// and calling convention; anything else is reported as an error.
 class ReturnStatement : public Statement {
  public:
-  explicit ReturnStatement(std::unique_ptr<Expression>&& expr)
-      : ret_expr_(std::move(expr)) {}
+  explicit ReturnStatement(Expression* expr, bool tail = false)
+      : ret_expr_(expr), tail_(tail) {}
   ~ReturnStatement() override = default;
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   std::string toString() override { return "return"; }
 
  private:
-  std::unique_ptr<Expression> ret_expr_;
+  llvm::Value* generateTailCall(DeviantLLVM& context);
+
+  Expression* ret_expr_;
+  bool tail_;
 };
 
+// fn name(a: type, ...) -> type { body }. Parameters are local variables
+// assigned the arguments. Functions not marked export, except main, are
+// only called from within the program: they get internal linkage and the
+// fast calling convention, so LLVM may change, inline or drop them.
 class FunctionStatement : public Statement {
  public:
-  explicit FunctionStatement(const std::string& fn_name) : fn_name_(fn_name) {}
+  // inline or noinline before fn
+  enum class Inlining { DEFAULT, ALWAYS, NEVER };
+
+  struct Parameter {
+    Symbol name;
+    ValueType type;
+  };
+
+  FunctionStatement(Symbol fn_name, Arena& arena)
+      : fn_name_(fn_name), params_(&arena) {}
   ~FunctionStatement() override = default;
-  Type type() override { return Type::STATEMENT; }
+  Type type() override { return Type::FUNCTION; }
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  // create the prototype and register it in the function table
+  void declare(DeviantLLVM& context);
   std::string toString() override { return "fn"; }
-  void setBlock(std::unique_ptr<Block>&& body) { body_ = std::move(body); }
+  void setBlock(Block* body) { body_ = body; }
+  void addParameter(Symbol name, ValueType type) {
+    params_.push_back({name, type});
+  }
+  void setReturnType(ValueType type) { return_type_ = type; }
+  void setInlining(Inlining inlining) { inlining_ = inlining; }
+  void setExported(bool exported) { exported_ = exported; }
+
+  Symbol getName() const { return fn_name_; }
 
  private:
-  std::string fn_name_;
-  std::unique_ptr<Block> body_;
+  Symbol fn_name_;
+  std::pmr::vector<Parameter> params_;
+  ValueType return_type_{ValueType::INT};
+  Inlining inlining_{Inlining::DEFAULT};
+  bool exported_{false};
+  Block* body_{nullptr};
 };
 
 class FunctionCall : public Statement {
  public:
-  explicit FunctionCall(const std::string& fn_name) : fn_name_(fn_name) {}
+  FunctionCall(Symbol fn_name, Arena& arena)
+      : fn_name_(fn_name), args_(&arena) {}
   ~FunctionCall() override = default;
-  Type type() override { return Type::STATEMENT; }
+  Type type() override { return Type::CALL; }
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   std::string toString() override { return "fn call"; }
 
-  void addArgument(std::unique_ptr<Expression>&& arg) {
-    args_.emplace_back(std::move(arg));
-  }
+  void addArgument(Expression* arg) { args_.push_back(arg); }
+  Symbol getName() const { return fn_name_; }
 
  private:
-  std::string fn_name_;
-  std::vector<std::unique_ptr<Expression>> args_;
+  Symbol fn_name_;
+  std::pmr::vector<Expression*> args_;
 };
 
+// Arithmetic on ints, wrapping on overflow, floats and vectors, lane by
+// lane. A scalar operand of a vector operation is splatted, and an int
+// operand of a float operation converted.
+class ArithmeticOp : public Expression {
+ public:
+  enum ArithOp { ADD, SUB, MUL, DIV };
+
+  explicit ArithmeticOp(Expression* lhs, ArithOp op, Expression* rhs)
+      : op_(op), lhs_(lhs), rhs_(rhs) {}
+
+  ~ArithmeticOp() override = default;
+
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::ARITHMETIC; }
+  std::string toString() override { return "arith"; }
+
+  ArithOp getOperator() const { return op_; }
+  Expression* getLHS() { return lhs_; }
+  Expression* getRHS() { return rhs_; }
+
+ private:
+  ArithOp op_;
+  Expression* lhs_;
+  Expression* rhs_;
+};
+
+// -operand: ints wrap around, floats only flip the sign, so -0.0 stays
+// negative. The parser folds it for literals.
+class Negation : public Expression {
+ public:
+  explicit Negation(Expression* operand) : operand_(operand) {}
+  ~Negation() override = default;
+
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::NEGATION; }
+  std::string toString() override { return "neg"; }
+
+  Expression* getOperand() { return operand_; }
+
+ private:
+  Expression* operand_;
+};
+
+// Signed integer or ordered float comparison; its value is 1 or 0.
 class ComparationOp : public Expression {
  public:
   enum CompOp { LT, LE, GT, GE, EQ, NE };
 
-  explicit ComparationOp(std::unique_ptr<Expression>&& lhs,
-                         CompOp op,
-                         std::unique_ptr<Expression>&& rhs)
-      : op_(op), lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+  explicit ComparationOp(Expression* lhs, CompOp op, Expression* rhs)
+      : op_(op), lhs_(lhs), rhs_(rhs) {}
 
   ~ComparationOp() override = default;
 
   llvm::Value* generateCode(DeviantLLVM& context) override;
-  std::string toString() override { return ""; }
+  llvm::Value* generateCondition(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::COMPARISON; }
+  std::string toString() override { return "cmp"; }
 
   CompOp getOperator() const { return op_; }
-  Expression* getLHS() { return lhs_.get(); }
-  Expression* getRHS() { return rhs_.get(); }
+  Expression* getLHS() { return lhs_; }
+  Expression* getRHS() { return rhs_; }
 
  private:
   CompOp op_;
-  std::unique_ptr<Expression> lhs_;
-  std::unique_ptr<Expression> rhs_;
+  Expression* lhs_;
+  Expression* rhs_;
+};
+
+// Build lhs op rhs in arena, folded while the tree is built as far as that
+// is exact for every type: constant operands are evaluated, constants move
+// to the right of + and * and x * 1, x / 1 drop out. Chains of constants
+// are combined on code generation, where the type of x is known.
+Expression* makeArithmetic(Arena& arena, Expression* lhs,
+                           ArithmeticOp::ArithOp op, Expression* rhs);
+Expression* makeComparison(Arena& arena, Expression* lhs,
+                           ComparationOp::CompOp op, Expression* rhs);
+
+// Builtins on vectors:
+//   i32x4(x), i32x4(a, b, c, d)  splat x into every lane, or one per lane
+//   shuffle(v, 3, 2, 1, 0)       lanes of v picked by constant indices
+//   shuffle(a, b, 0, 4, 1, 5)    the same from the lanes of a then b
+//   reduce(v)                    sum of the lanes
+class VectorOp : public Expression {
+ public:
+  enum VecOp { BUILD, SHUFFLE, REDUCE };
+
+  VectorOp(VecOp op, ValueType result, Arena& arena)
+      : op_(op), result_(result), args_(&arena) {}
+  ~VectorOp() override = default;
+
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::EXPRESSTION; }
+  std::string toString() override { return "vector op"; }
+
+  void addArgument(Expression* arg) { args_.push_back(arg); }
+
+ private:
+  llvm::Value* generateBuild(DeviantLLVM& context);
+  llvm::Value* generateShuffle(DeviantLLVM& context);
+
+  VecOp op_;
+  ValueType result_;  // of BUILD
+  std::pmr::vector<Expression*> args_;
+};
+
+// a[i], an element of an array, with a bounds check, or v[i], a lane of a
+// vector. A lane index computed at run time wraps around.
+class Subscript : public Expression {
+ public:
+  Subscript(Expression* base, Expression* index)
+      : base_(base), index_(index) {}
+  ~Subscript() override = default;
+
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  Type type() override { return Type::EXPRESSTION; }
+  std::string toString() override { return "subscript"; }
+
+ private:
+  Expression* base_;
+  Expression* index_;
 };
 
 class IfStatement : public Statement {
  public:
+  // expected outcome of the condition, from @likely and @unlikely
+  enum class Hint { NONE, LIKELY, UNLIKELY };
+
   explicit IfStatement() {}
   ~IfStatement() override = default;
-  void setCondition(std::unique_ptr<Expression>&& condition) {
-    condition_ = std::move(condition);
-  }
-  void setThenBlock(std::unique_ptr<Block>&& then_block) {
-    then_ = std::move(then_block);
-  }
-  void setElseBlock(std::unique_ptr<Block>&& else_block) {
-    else_ = std::move(else_block);
-  }
+  void setCondition(Expression* condition) { condition_ = condition; }
+  void setThenBlock(Block* then_block) { then_ = then_block; }
+  void setElseBlock(Block* else_block) { else_ = else_block; }
+  void setHint(Hint hint) { hint_ = hint; }
 
+  Type type() override { return Type::CONDITIONAL; }
   llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
   std::string toString() override { return ""; }
 
  private:
-  std::unique_ptr<Expression> condition_;
-  std::unique_ptr<Block> then_;
-  std::unique_ptr<Block> else_;
+  Expression* condition_{nullptr};
+  Block* then_{nullptr};
+  Block* else_{nullptr};
+  Hint hint_{Hint::NONE};
+};
+
+// for (init; condition; step) { body }, and while (condition) { body } as a
+// for without init and step. A missing condition loops forever. Generated
+// as a canonical loop: the block before it is the preheader, the header
+// tests the condition and the latch runs the step and branches back.
+class LoopStatement : public Statement {
+ public:
+  // from @vectorize and @novectorize
+  enum class Vectorize { DEFAULT, ENABLE, DISABLE };
+
+  explicit LoopStatement(Arena& arena) : init_(arena.make<Block>(arena)) {}
+  ~LoopStatement() override = default;
+  void addInit(Statement* stmt) { init_->insertStatement(stmt); }
+  void setCondition(Expression* condition) { condition_ = condition; }
+  void setStep(Statement* step) { step_ = step; }
+  void setBody(Block* body) { body_ = body; }
+  // from @unroll(N); 0 leaves the decision to the optimizer, 1 disables
+  // unrolling
+  void setUnrollCount(uint32_t count) { unroll_count_ = count; }
+  void setVectorize(Vectorize vectorize) { vectorize_ = vectorize; }
+
+  Type type() override { return Type::LOOP; }
+  llvm::Value* generateCode(DeviantLLVM& context) override;
+  void hash(AstHasher& hasher) override;
+  std::string toString() override { return "loop"; }
+
+ private:
+  Block* init_;
+  Expression* condition_{nullptr};
+  Statement* step_{nullptr};
+  Block* body_{nullptr};
+  uint32_t unroll_count_{0};
+  Vectorize vectorize_{Vectorize::DEFAULT};
 };
 
 }  // namespace deviant
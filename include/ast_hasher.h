@@ -0,0 +1,75 @@
+#ifndef __AST_HASHER_H__
+#define __AST_HASHER_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Support/SHA1.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "ast.h"
+#include "interner.h"
+
+namespace deviant {
+
+// Stable digest of an AST subtree, used as a content address. Names enter
+// the digest as text rather than Symbols, which differ between compilations,
+// and every field is length- or tag-prefixed so that different trees cannot
+// produce the same byte stream. Callees met on the way are collected so
+// that their signatures can be added to the key as well.
+class AstHasher {
+ public:
+  explicit AstHasher(const Interner& interner) : interner_(interner) {}
+
+  void add(std::string_view text) {
+    add(static_cast<int64_t>(text.size()));
+    sha1_.update(llvm::StringRef(text.data(), text.size()));
+  }
+
+  void add(int64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) {
+      bytes[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+    }
+    sha1_.update(bytes);
+  }
+
+  void addName(Symbol symbol) { add(interner_.name(symbol)); }
+
+  void addCall(Symbol callee) {
+    addName(callee);
+    callees_.push_back(callee);
+  }
+
+  void add(AstNode* node) {
+    if (node) {
+      node->hash(*this);
+    } else {
+      add("null");
+    }
+  }
+
+  // callees in the order they were hashed
+  const std::vector<Symbol>& callees() const { return callees_; }
+
+  // hex digest; the hasher is spent afterwards
+  std::string finish() { return llvm::toHex(sha1_.final(), true); }
+
+ private:
+  const Interner& interner_;
+  llvm::SHA1 sha1_;
+  std::vector<Symbol> callees_;
+};
+
+}  // namespace deviant
+
+#endif  // __AST_HASHER_H__
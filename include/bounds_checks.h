@@ -0,0 +1,48 @@
+#ifndef __BOUNDS_CHECKS_H__
+#define __BOUNDS_CHECKS_H__
+
+#include <cstddef>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+// Bounds checks of array accesses. A check is a branch on index < length
+// whose false edge reports the index and exits; accesses with a constant
+// index are checked while the code is generated and get none. Once a
+// function is complete, scalar evolution tries to prove its remaining
+// checks always pass, e.g. for a loop counter bounded by the array length,
+// and those are removed again.
+class BoundsChecks {
+ public:
+  // check branches to its first successor when the index is in range
+  void add(llvm::BranchInst* check) { pending_.push_back(check); }
+
+  // an access that got no check
+  void skip() { ++removed_; }
+
+  // remove the checks added since the last call that always pass
+  void eliminate(llvm::Function& fn);
+
+  size_t removed() const { return removed_; }
+  size_t kept() const { return kept_; }
+
+ private:
+  std::vector<llvm::BranchInst*> pending_;
+  size_t removed_{0};
+  size_t kept_{0};
+};
+
+}  // namespace deviant
+
+#endif  // __BOUNDS_CHECKS_H__
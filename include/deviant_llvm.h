@@ -1,8 +1,10 @@
 #ifndef __DEVIANT_LLVM__
 #define __DEVIANT_LLVM__
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #if defined(_MSC_VER)
@@ -13,135 +15,336 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
 
 #if defined(_MSC_VER)
 #pragma warning(pop)
 #endif
 
+#include "arena.h"
 #include "ast.h"
+#include "bounds_checks.h"
+#include "function_cache.h"
+#include "interner.h"
+#include "options.h"
+#include "output_file.h"
 #include "parser.h"
+#include "scope_table.h"
+#include "ssa_builder.h"
 
 namespace deviant {
 
-class CodeGenBlock {
- public:
-  CodeGenBlock(llvm::BasicBlock* bb) { bblock_ = bb; }
-  ~CodeGenBlock() {}
-  void setCodeBlock(llvm::BasicBlock* bb) { bblock_ = bb; }
-  llvm::BasicBlock* currentBlock() { return bblock_; }
-  std::map<std::string, llvm::AllocaInst*>& getValueNames() { return locals_; }
-  std::map<std::string, std::string>& getTypeMap() { return types_; }
-
- private:
-  llvm::BasicBlock* bblock_{nullptr};
-  std::map<std::string, llvm::AllocaInst*> locals_;
-  std::map<std::string, std::string> types_;
-};
-
 class DeviantLLVM {
  public:
-  DeviantLLVM();
+  explicit DeviantLLVM(const CompileOptions& options = {});
 
-  void execute(const std::string& program) {
-    // parse the program
-    parser_ = std::make_unique<Parser>(program);
-    auto ast = parser_->parse();
+  // Compile program and, depending on the mode, save or run it. Returns the
+  // process exit status: main's return value in run mode. program must stay
+  // alive until the parser is gone.
+  int execute(std::string_view program);
 
-    // compile to LLVM IR
-    compile(*ast);
+  // Release the module and wait for the output file, which is written in the
+  // background meanwhile. Returns false if the output could not be written.
+  [[nodiscard]] bool finish();
 
-#ifdef _DEBUG
-// print generated codex
-    module_->print(llvm::outs(), nullptr);
-#endif
+  // The steps of execute() that benchmarks time on their own: parse
+  // program into an AST, then generate its IR into getModule().
+  Program* parse(std::string_view program);
+
+  void compile(Program& ast) {
+    // compile main body
+    ast.generateCode(*this);
+  }
 
-    // save module IR to file
-    saveModuleToFile("./out.ll");
+  // print "Deviant Error: " and return the stream for the rest of the
+  // message; any error fails the compile
+  llvm::raw_ostream& error() {
+    ++errors_;
+    return llvm::errs() << "Deviant Error: ";
   }
 
+  // errors reported while generating code
+  size_t errors() const { return errors_; }
+
   llvm::LLVMContext& getGlobalContext() { return *context_.get(); }
 
   llvm::Type* getGenericIntegerType() {
     return llvm::Type::getInt32Ty(getGlobalContext());
   }
 
+  llvm::Type* getType(ValueType type) {
+    llvm::LLVMContext& context = getGlobalContext();
+    switch (type) {
+      case ValueType::INT:
+        return getGenericIntegerType();
+      case ValueType::FLOAT:
+        return llvm::Type::getFloatTy(context);
+      case ValueType::I32X4:
+        return llvm::FixedVectorType::get(getGenericIntegerType(), 4);
+      case ValueType::I32X8:
+        return llvm::FixedVectorType::get(getGenericIntegerType(), 8);
+      case ValueType::F32X8:
+        return llvm::FixedVectorType::get(llvm::Type::getFloatTy(context), 8);
+    }
+    return nullptr;
+  }
+
   llvm::Module* getModule() { return module_.get(); }
 
   llvm::IRBuilder<>* getBuilder() { return builder_.get(); }
 
+  // AST nodes and their containers
+  Arena& getArena() { return arena_; }
+
+  Interner& getInterner() { return interner_; }
+
+  std::string_view getSymbolName(Symbol symbol) const {
+    return interner_.name(symbol);
+  }
+
+  Symbol getPrintSymbol() const { return print_symbol_; }
+
+  // runtime function behind the print builtin for an int or a float
+  llvm::Function* getPrintFunction(llvm::Type* type) {
+    if (!type->isFloatTy())
+      return print_fn_;
+    return getRuntimeFunction("deviant_print_f32", {type});
+  }
+
+  // runtime function reporting an array index out of bounds and exiting
+  llvm::Function* getBoundsFailFunction() {
+    llvm::Type* i32 = builder_->getInt32Ty();
+    auto fn = llvm::cast<llvm::Function>(
+        module_
+            ->getOrInsertFunction(
+                "deviant_bounds_fail",
+                llvm::FunctionType::get(builder_->getVoidTy(), {i32, i32},
+                                        false /* not var arg */))
+            .getCallee());
+    fn->setDoesNotReturn();
+    fn->setDoesNotThrow();
+    fn->addFnAttr(llvm::Attribute::Cold);
+    return fn;
+  }
+
+  // runtime function printing lane i of n of a vector, as part of <a, b>
+  llvm::Function* getPrintLaneFunction(llvm::Type* element) {
+    llvm::Type* i32 = builder_->getInt32Ty();
+    return getRuntimeFunction(element->isFloatTy() ? "deviant_print_lane_f32"
+                                                   : "deviant_print_lane_i32",
+                              {element, i32, i32});
+  }
+
+  // function table indexed by Symbol, filled by FunctionStatement::declare;
+  // functions registered with registerDeclaration are declared on first use
+  llvm::Function* getFunction(Symbol symbol) {
+    if (symbol < functions_.size() && functions_[symbol])
+      return functions_[symbol];
+    if (symbol < declarations_.size() && declarations_[symbol]) {
+      FunctionStatement* fn = declarations_[symbol];
+      declarations_[symbol] = nullptr;
+      fn->declare(*this);
+      return getFunction(symbol);
+    }
+    return nullptr;
+  }
+
+  // a function defined outside the part of the program being compiled
+  void registerDeclaration(FunctionStatement* fn) {
+    if (fn->getName() >= declarations_.size()) {
+      declarations_.resize(interner_.size(), nullptr);
+    }
+    declarations_[fn->getName()] = fn;
+  }
+
+  void registerFunction(Symbol symbol, llvm::Function* fn) {
+    if (symbol >= functions_.size()) {
+      functions_.resize(interner_.size(), nullptr);
+    }
+    functions_[symbol] = fn;
+  }
+
+  // fastcc and internal linkage for a function only called from within the
+  // program; sharded, it stays visible to the other shards, as hidden, until
+  // they are linked
+  void makeInternal(llvm::Function* fn) {
+    fn->setCallingConv(llvm::CallingConv::Fast);
+    if (sharded()) {
+      fn->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    } else {
+      fn->setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+  }
+
+  // number of AST nodes built by the last execute()
+  size_t astNodes() const { return ast_nodes_; }
+
+  void printArenaStats(llvm::raw_ostream& os) const;
+
+  // MemStats phases and totals plus token, AST node and instruction counts
+  // of the last execute(), as JSON
+  void printMemStats(llvm::raw_ostream& os) const;
+
+  // open a scope whose code goes to bb
   void newScope(llvm::BasicBlock* bb) {
     if (!bb) {
       bb = llvm::BasicBlock::Create(getGlobalContext(), "scope");
     }
-    code_blocks_.push_front(new CodeGenBlock(bb));
+    scope_blocks_.push_back(bb);
+    builder_->SetInsertPoint(bb);
+    variables_.enterScope();
   }
 
-  void endScope() {
-    CodeGenBlock* top = code_blocks_.front();
-    code_blocks_.pop_front();
-    delete top;
-  }
+  // close the innermost scope and continue in the block of the enclosing
+  // one; closing the function's scope forgets its variables
+  void endScope();
 
   // set the LLVM block where to put the next instructions
   void setInsertPoint(llvm::BasicBlock* bblock) { setCurrentBlock(bblock); }
 
-  llvm::AllocaInst* findVariable(const std::string& var_name) {
-    // Only look in current scope, since outer scope isn't valid while in
-    // function declaration.
-    auto& names = locals();
-    if (names.find(var_name) != names.end()) {
-      return names[var_name];
-    }
-    // return nullptr;
-
-    // Travers from inner to outer scope (block) to find the variable.
-    for (auto& cb : code_blocks_) {
-      auto& names = cb->getValueNames();
-      if (names.find(var_name) != names.end()) {
-        return names[var_name];
-      }
+  // all predecessors of block have been emitted; reads of variables in it
+  // can now be resolved completely
+  void sealBlock(llvm::BasicBlock* block) {
+    if (options_.ssa) {
+      ssa_.seal(block);
     }
-
-    return nullptr;
   }
 
-  void conductVar(std::string var_name, llvm::AllocaInst* alloca) {
-    code_blocks_.front()->getValueNames()[var_name] = alloca;
+  // innermost visible declaration of var_name
+  Variable* findVariable(Symbol var_name) {
+    if (Variable* var = variables_.find(var_name))
+      return var;
+    return findGlobal(var_name);
   }
 
-  llvm::BasicBlock* currentBlock() {
-    return code_blocks_.front()->currentBlock();
-  }
+  // declare var_name in the innermost scope; null if it already is
+  Variable* declareVariable(Symbol var_name, llvm::Type* type);
 
-  std::map<std::string, llvm::AllocaInst*>& locals() {
-    return code_blocks_.front()->getValueNames();
-  }
+  // an array on the stack, like declareVariable
+  Variable* declareArray(Symbol var_name, llvm::ArrayType* type);
+
+  // Global arrays, see ArrayDeclaration. The module declares one on first
+  // use, and the code of its declaration defines it; registerGlobal makes
+  // one defined outside the part of the program being compiled known.
+  Variable* findGlobal(Symbol var_name);
+  Variable* declareGlobal(Symbol var_name, llvm::ArrayType* type);
+  void registerGlobal(ArrayDeclaration* array);
+
+  // Check index < length before an array access: at compile time for a
+  // constant index, false with a compile error if it is out of bounds,
+  // else with a branch to a runtime error, after which code continues in a
+  // new block. Unless options disable them, the checks of a function stay
+  // in place where eliminateBoundsChecks cannot prove them redundant.
+  bool checkBounds(llvm::Value* index, uint64_t length);
+  void eliminateBoundsChecks(llvm::Function& fn);
+
+  // bounds checks removed and kept, on stderr with -v
+  void printBoundsCheckStats(llvm::raw_ostream& os) const;
+
+  // the value of var at the end of the current block: a load of its stack
+  // slot, or its SSA definition
+  llvm::Value* readVariable(Variable* var);
+
+  void writeVariable(Variable* var, llvm::Value* value);
+
+  llvm::BasicBlock* currentBlock() { return scope_blocks_.back(); }
 
  private:
+  // worker for parallel code generation: a module and context of its own,
+  // names resolved through a copy of the parent's interner
+  DeviantLLVM(const CompileOptions& options, const Interner& interner);
+
   void setCurrentBlock(llvm::BasicBlock* block) {
-    code_blocks_.front()->setCodeBlock(block);
+    scope_blocks_.back() = block;
+    builder_->SetInsertPoint(block);
   }
 
   void initModule();
 
-  void saveModuleToFile(const std::string& filename);
+  // a stack slot allocated once on function entry
+  llvm::AllocaInst* createEntryAlloca(llvm::Type* type, llvm::StringRef name);
 
-  void compile(Program& ast) {
-    // compile main body
-    ast.generateCode(*this);
+  bool optimizing() const {
+    return options_.opt_level != OptLevel::O0 || !options_.passes.empty();
   }
 
+  // compiled on several threads or through the cache, see executeSharded
+  bool sharded() const {
+    return options_.jobs != 1 || !options_.cache_dir.empty();
+  }
+
+  // split the functions of ast into one shard per job, or one per function
+  // with a cache, compile and optimize the shards on a thread pool, or take
+  // them from the cache, and merge the results in source order
+  int executeSharded(Program& ast);
+
+  // content address of the code generated for stmt: its subtree, the
+  // signatures of its callees and everything else the code depends on
+  std::string cacheKey(Statement* stmt, const std::string& config);
+
+  // worker side: generate statements [first, last) of ast, optimize them and
+  // serialize the module as bitcode, or as an object file if object is set
+  bool compileShard(Program& ast, size_t first, size_t last, bool object,
+                    CodeBuffer& out);
+
+  // link the bitcode of all shards, in order, into this module; functions
+  // hidden by makeInternal become internal then
+  bool linkShards(const std::vector<CodeBuffer>& shards);
+
+  // write out the finished module as selected by the mode
+  int emit();
+
+  // create the host TargetMachine and attach its triple and data layout to
+  // the module; needed before optimizing or emitting machine code
+  bool initTarget();
+
+  // false with an error if -passes= does not parse
+  bool checkPassPipeline() const;
+
+  // run the pipeline the options select, or kPostLinkPasses on merged
+  // shards if post_link is set; false with an error if the module is invalid
+  // or the pipeline does not parse
+  bool optimize(bool post_link = false);
+
+  // emit a native object file for the host
+  bool emitObject(llvm::raw_pwrite_stream& out);
+
+  // emit an object to a temporary file and link it with the runtime
+  bool emitExecutable(const std::string& filename);
+
+  // write objects to temporary files and link them with the runtime
+  bool linkExecutable(const std::vector<CodeBuffer>& objects,
+                      const std::string& filename);
+
+  // hand the module over to an ORC LLJIT and call main; the module and its
+  // context belong to the JIT afterwards
+  int runJIT();
+
+  // serialize the module in the given format and start writing it out
+  bool writeModule(Emit emit, const std::string& filename);
+
   void setupExternFunctions() {
-    // i8* to substitute for char*, void*, etc
-    auto byte_ptr_Ty = builder_->getInt8Ty()->getPointerTo();
+    // int deviant_print_i32(int), see runtime/deviant_rt.c
+    print_fn_ = llvm::cast<llvm::Function>(
+        module_
+            ->getOrInsertFunction(
+                "deviant_print_i32",
+                llvm::FunctionType::get(builder_->getInt32Ty(),
+                                        {builder_->getInt32Ty()},
+                                        false /* not var arg */))
+            .getCallee());
+  }
 
-    // int print(const char* format, ...)
-    module_->getOrInsertFunction(
-        "printf",
-        llvm::FunctionType::get(
-            llvm::IntegerType::getInt32Ty(*context_),
-            llvm::PointerType::get(llvm::Type::getInt8Ty(*context_), 0),
-            true /* this is var arg func type*/));
+  // int name(params...) of runtime/deviant_rt.c, declared on first use
+  llvm::Function* getRuntimeFunction(llvm::StringRef name,
+                                     llvm::ArrayRef<llvm::Type*> params) {
+    return llvm::cast<llvm::Function>(
+        module_
+            ->getOrInsertFunction(
+                name, llvm::FunctionType::get(builder_->getInt32Ty(), params,
+                                              false /* not var arg */))
+            .getCallee());
   }
 
   llvm::Function* createFunction(const std::string& fn_name,
@@ -178,6 +381,28 @@ class DeviantLLVM {
     return llvm::BasicBlock::Create(*context_, name, fn);
   }
 
+  CompileOptions options_;
+
+  // declared first so it is released last, after everything pointing in
+  Arena arena_;
+  size_t ast_nodes_{0};
+  size_t tokens_{0};
+  size_t instructions_{0};  // generated by codegen, counted for --mem-stats
+  size_t errors_{0};
+
+  Interner interner_;
+  Symbol print_symbol_;
+  std::vector<llvm::Function*> functions_;
+  std::vector<FunctionStatement*> declarations_;
+  // global arrays indexed by Symbol, like the functions
+  std::deque<Variable> global_variables_;
+  std::vector<Variable*> globals_;
+  std::vector<ArrayDeclaration*> global_declarations_;
+  BoundsChecks bounds_checks_;
+  size_t bounds_removed_{0};  // by the workers of a sharded compile
+  size_t bounds_kept_{0};
+  llvm::Function* print_fn_{nullptr};
+
   std::unique_ptr<Parser> parser_;
 
   // currently complier function
@@ -185,7 +410,14 @@ class DeviantLLVM {
   std::unique_ptr<llvm::LLVMContext> context_;
   std::unique_ptr<llvm::Module> module_;
   std::unique_ptr<llvm::IRBuilder<>> builder_;
-  std::list<CodeGenBlock*> code_blocks_;
+  std::unique_ptr<llvm::TargetMachine> target_machine_;
+  std::unique_ptr<OutputFile> output_;
+  // scope stack: the current block of each open scope, innermost at the
+  // back, and the variables of all open scopes
+  std::vector<llvm::BasicBlock*> scope_blocks_;
+  ScopeTable<Variable> variables_;
+  std::deque<Variable> function_variables_;  // of the current function
+  SsaBuilder ssa_;
 };
 
 }  // namespace deviant
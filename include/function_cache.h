@@ -0,0 +1,60 @@
+#ifndef __FUNCTION_CACHE_H__
+#define __FUNCTION_CACHE_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "output_file.h"
+
+namespace deviant {
+
+// Content-addressed on-disk store of compiled functions: one file per key in
+// a directory. Entries are written under a temporary name and renamed into
+// place, so concurrent compilers never read a partial entry. Hits refresh
+// the entry's modification time and flush() evicts the least recently used
+// entries until the directory fits its size limit again.
+class FunctionCache {
+ public:
+  FunctionCache(std::string dir, uint64_t max_bytes)
+      : dir_(std::move(dir)), max_bytes_(max_bytes) {}
+
+  // create the directory if needed; return false if it is unusable
+  [[nodiscard]] bool open();
+
+  // return true and the entry's contents if key is cached
+  bool lookup(const std::string& key, CodeBuffer& code);
+
+  // start writing code under key
+  void store(const std::string& key, const CodeBuffer& code);
+
+  // finish the stores, then trim the cache to its size limit
+  void flush();
+
+  void printStats(llvm::raw_ostream& os) const;
+
+ private:
+  std::string path(const std::string& key) const;
+
+  void evict();
+
+  struct Pending {
+    std::unique_ptr<OutputFile> file;
+    std::string temp;
+    std::string path;
+  };
+
+  std::string dir_;
+  uint64_t max_bytes_;
+  std::vector<Pending> pending_;
+
+  size_t hits_{0};
+  size_t misses_{0};
+  size_t evicted_{0};
+  uint64_t bytes_{0};  // size of the cache after the last flush()
+};
+
+}  // namespace deviant
+
+#endif  // __FUNCTION_CACHE_H__
@@ -0,0 +1,42 @@
+#ifndef __INTERNER_H__
+#define __INTERNER_H__
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace deviant {
+
+// Interned identifier. Ids are dense, starting at 0, so they can index
+// plain vectors.
+using Symbol = uint32_t;
+
+constexpr Symbol kNoSymbol = UINT32_MAX;
+
+// Maps every distinct identifier of a compilation to a Symbol. Names are not
+// copied: they must stay alive as long as the interner (slices of the source
+// buffer or string literals).
+class Interner {
+ public:
+  Symbol intern(std::string_view name) {
+    auto [it, inserted] =
+        ids_.try_emplace(name, static_cast<Symbol>(names_.size()));
+    if (inserted) {
+      names_.push_back(name);
+    }
+    return it->second;
+  }
+
+  std::string_view name(Symbol symbol) const { return names_[symbol]; }
+
+  size_t size() const { return names_.size(); }
+
+ private:
+  std::unordered_map<std::string_view, Symbol> ids_;
+  std::vector<std::string_view> names_;
+};
+
+}  // namespace deviant
+
+#endif  // __INTERNER_H__
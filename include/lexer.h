@@ -1,166 +1,92 @@
 #ifndef __LEXER_H__
 #define __LEXER_H__
 
-#include <iostream>
-#include <optional>
-#include <string>
+#include <array>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
+#include "interner.h"
+#include "timer.h"
 #include "token.h"
 
 namespace deviant {
 class Lexer {
  public:
-  explicit Lexer(const std::string& src);
-
-  inline void tokenize() {
-    std::string buf("");
-    while (peek().has_value()) {
-      if (std::isalpha(peek().value())) {
-        buf += consume();
-        while (peek().has_value() && std::isalnum(peek().value())) {
-          buf.push_back(consume());
-        }
-        if (buf == "ret") {
-          tokens_.push_back({.type = TokenType::RETURN});
-          buf.clear();
-        } else if (buf == "var") {
-          tokens_.push_back({.type = TokenType::VAR});
-          buf.clear();
-        } else if (buf == "if") {
-          tokens_.push_back({.type = TokenType::IF});
-          buf.clear();
-        } else if (buf == "else") {
-          tokens_.push_back({.type = TokenType::ELSE});
-          buf.clear();
-        } else if (buf == "fn") {
-          tokens_.push_back({.type = TokenType::FN});
-          buf.clear();
-        } else if (buf == "int") {
-          tokens_.push_back({.type = TokenType::INT});
-          buf.clear();
-        } else {
-          tokens_.push_back({.type = TokenType::IDENTIFIER, .value = buf});
-          buf.clear();
-        }
-      } else if (std::isdigit(peek().value())) {
-        buf.push_back(consume());
-        while (peek().has_value() && std::isdigit(peek().value())) {
-          buf.push_back(consume());
-        }
-        tokens_.push_back({.type = TokenType::INT_LIT, .value = buf});
-        buf.clear();
-      } else if (peek().value() == '(') {
-        consume();
-        tokens_.push_back({.type = TokenType::OPEN_PAREN});
-      } else if (peek().value() == ')') {
-        consume();
-        tokens_.push_back({.type = TokenType::CLOSE_PAREN});
-      } else if (peek().value() == ',') {
-        consume();
-        tokens_.push_back({.type = TokenType::COMMA});
-      } else if (peek().value() == ';') {
-        consume();
-        tokens_.push_back({.type = TokenType::SEMICOLON});
-      } else if (peek().value() == '=') {
-        if (peek(1).has_value() &&
-            peek(1).value() == '=') {  // deal with comment
-          consume();
-          consume();
-          tokens_.push_back({.type = TokenType::EQ});
-        } else {
-          consume();
-          tokens_.push_back({.type = TokenType::ASSIGNMENT});
-        }
-      } else if (peek().value() == '+') {
-        consume();
-        tokens_.push_back({.type = TokenType::PLUS});
-      } else if (peek().value() == '*') {
-        consume();
-        tokens_.push_back({.type = TokenType::STAR});
-      } else if (peek().value() == '-') {
-        consume();
-        if (peek().value() == '>') {
-          consume();
-          tokens_.push_back({.type = TokenType::FN_TYPE});
-        } else {
-          tokens_.push_back({.type = TokenType::MINUS});
-        }
-      } else if (peek().value() == '/') {
-        if (peek(-1).value() == '/') {  // deal with comment
-          tokens_.pop_back();
-          char c = '/';
-          while (c != '\n') {
-            c = consume();
-          }
-        } else {
-          consume();
-          tokens_.push_back({.type = TokenType::FSLASH});
-        }
-      } else if (peek().value() == '<') {
-        if (peek(1).has_value() &&
-            peek(1).value() == '=') {  // deal with comment
-          consume();
-          consume();
-          tokens_.push_back({.type = TokenType::LE});
-        } else {
-          consume();
-          tokens_.push_back({.type = TokenType::LT});
-        }
-      } else if (peek().value() == '>') {
-        if (peek(1).has_value() &&
-            peek(1).value() == '=') {  // deal with comment
-          consume();
-          consume();
-          tokens_.push_back({.type = TokenType::GE});
-        } else {
-          consume();
-          tokens_.push_back({.type = TokenType::GT});
-        }
-      } else if (peek().value() == '!') {
-        if (peek(1).has_value() &&
-            peek(1).value() == '=') {  // deal with comment
-          consume();
-          consume();
-          tokens_.push_back({.type = TokenType::NE});
-        } else {
-          consume();
-          tokens_.push_back({.type = TokenType::EXCLAMATION});
-        }
-      } else if (peek().value() == '{') {
-        consume();
-        tokens_.push_back({.type = TokenType::OPEN_CURLY});
-      } else if (peek().value() == '}') {
-        consume();
-        tokens_.push_back({.type = TokenType::CLOSE_CURLY});
-      } else if (std::isspace(peek().value())) {
-        consume();
-      } else if (peek().value() == '\0') {
-        break;
-      } else {
-        std::cerr << "You messed up!" << std::endl;
-        exit(EXIT_FAILURE);
-      }
-    }
-    index_ = 0;
+  // the lexer scans src in place and interns identifiers into interner; both
+  // must outlive the lexer
+  Lexer(std::string_view src, Interner& interner);
+
+  // scan the whole source into the token arrays
+  void tokenize();
+
+  size_t size() const { return types_.size(); }
+
+  TokenType type(size_t i) const { return types_[i]; }
+
+  std::string_view text(size_t i) const {
+    return str_.substr(offsets_[i], lengths_[i]);
+  }
+
+  Symbol symbol(size_t i) const { return symbols_[i]; }
+
+  Token token(size_t i) const {
+    Token token;
+    token.setType(types_[i]);
+    token.length = lengths_[i];
+    token.offset = offsets_[i];
+    token.symbol = symbols_[i];
+    return token;
   }
 
-  const std::vector<Token>& getTokens() const { return tokens_; }
+  // Streaming mode, an alternative to tokenize(): tokens are scanned on
+  // demand into a ring of kStreamWindow entries, so memory stays bounded no
+  // matter how large the source is. Returns the token with absolute index i,
+  // or nullptr past the end of input. Only the last kStreamWindow scanned
+  // tokens can be revisited.
+  const Token* stream(size_t i);
+
+  std::string_view text(const Token& token) const {
+    return str_.substr(token.offset, token.length);
+  }
+
+  // Must cover every token the parser can look at from its current one:
+  // one back (peek(-1)) and up to three ahead (peek(3), for the parameter
+  // lists and declarations), five in all. Twice that leaves room for the
+  // grammar to grow; stream() fails loudly if it is not enough.
+  static constexpr size_t kStreamWindow = 8;
+
+  // tokens scanned so far in streaming mode
+  size_t scanned() const { return scanned_; }
+
+  // record the time spent scanning in stream(), see TimeAccumulator
+  void flushTimer() { scan_time_.flush(); }
 
  private:
-  [[nodiscard]] inline std::optional<char> peek(const int offset = 0) const {
-    if (index_ + offset >= str_.length()) {
-      return {};
-    } else {
-      return str_.at(index_ + offset);
-    }
+  // scan the token starting at index_, return false at the end of input
+  bool scanToken(Token& token);
+
+  inline void addToken(const Token& token) {
+    types_.push_back(token.type());
+    offsets_.push_back(token.offset);
+    lengths_.push_back(token.length);
+    symbols_.push_back(token.symbol);
   }
 
-  inline char consume() { return str_.at(index_++); }
+  // tokens are stored struct-of-arrays; see Token for the layout
+  std::vector<TokenType> types_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> lengths_;
+  std::vector<Symbol> symbols_;
+
+  std::array<Token, kStreamWindow> window_{};
+  size_t scanned_{0};  // tokens produced so far in streaming mode
+  bool exhausted_{false};
+  TimeAccumulator scan_time_{"phase", "lex (streamed into parse)"};
 
-  std::vector<Token> tokens_;
+  Interner& interner_;
 
-  std::string str_;
+  std::string_view str_;
 
   size_t index_;
 };
@@ -0,0 +1,61 @@
+#ifndef __MEM_STATS_H__
+#define __MEM_STATS_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace deviant {
+
+// Heap statistics for --mem-stats. The global operator new and delete are
+// replaced by counting versions (see mem_stats.cpp) that only touch the
+// counters once enable() was called; before that they cost a flag check on
+// top of malloc. Memory that does not go through operator new, such as the
+// Arena's blocks or LLVM's malloc-based containers, shows up in the RSS
+// figures only.
+//
+// Blocks allocated before enable() carry no mark, so freeing one later
+// subtracts it like a counted block. Live bytes are clamped at zero rather
+// than underflowing; they may read low by the size of such blocks. That
+// is small in practice: main() enables the stats right after parsing the
+// command line, before the source is read.
+//
+// Phases are opened and closed by the "phase" ScopedTimers of the main
+// thread; allocations of worker threads count towards the phase the main
+// thread is in.
+class MemStats {
+ public:
+  struct Phase {
+    std::string name;
+    int depth;                // nesting level, 0 for outermost phases
+    uint64_t allocations;     // operator new calls during the phase
+    uint64_t bytes;           // bytes they returned
+    int64_t peak_live_bytes;  // most bytes held by operator new at once
+    int64_t peak_rss_bytes;   // resident set high-water mark, -1 if unknown
+  };
+
+  static bool enabled() { return enabled_; }
+
+  static void enable();
+
+  static void beginPhase(std::string_view name);
+  static void endPhase();
+
+  // finished phases, in the order they began
+  static const std::vector<Phase>& phases();
+
+  // the same figures for everything since enable()
+  static Phase total();
+
+  // used by the replaced operators
+  static void onAllocate(void* ptr);
+  static void onFree(void* ptr);
+
+ private:
+  static inline bool enabled_{false};
+};
+
+}  // namespace deviant
+
+#endif  // __MEM_STATS_H__
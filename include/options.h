@@ -0,0 +1,75 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <cstdint>
+#include <string>
+
+namespace deviant {
+
+enum class OptLevel { O0, O1, O2, O3, Os };
+
+enum class Mode {
+  COMPILE,    // write the module to a file in the emit format
+  RUN,        // JIT-compile the module in process and call main
+  EXECUTABLE  // emit an object and link it with the runtime (-o)
+};
+
+// file format of Mode::COMPILE
+enum class Emit {
+  LL,   // textual IR, for humans
+  BC,   // bitcode, much cheaper to write and read back
+  OBJ   // native object file
+};
+
+// Settings of one compiler invocation, filled from the command line by
+// UserInput and consumed by DeviantLLVM.
+struct CompileOptions {
+  Mode mode{Mode::COMPILE};
+
+  OptLevel opt_level{OptLevel::O0};
+
+  Emit emit{Emit::BC};
+
+  // output path of Mode::COMPILE and Mode::EXECUTABLE
+  std::string output{"./out.bc"};
+
+  // worker threads for code generation and optimization (-j); 1 keeps
+  // everything on the calling thread, 0 uses every hardware thread
+  unsigned jobs{1};
+
+  // directory of the per-function compilation cache; empty disables it
+  std::string cache_dir;
+
+  // the least recently used cache entries are evicted beyond this size
+  uint64_t cache_size{512ull << 20};
+
+  // textual pass pipeline (opt's -passes syntax); replaces the default
+  // pipeline of opt_level when set
+  std::string passes;
+
+  // build local variables in SSA form with phi nodes; --no-ssa keeps every
+  // variable in a stack slot with loads and stores, for mem2reg to clean up
+  bool ssa{true};
+
+  // check array indices at run time where the compiler cannot prove them in
+  // range; --no-bounds-checks trusts every index
+  bool bounds_checks{true};
+
+  // report statistics and timings on stderr
+  bool verbose{false};
+
+  // per-phase, per-function and per-pass times on stderr (--time-report)
+  bool time_report{false};
+
+  // allocation and RSS statistics per phase as JSON (--mem-stats[=file]);
+  // written to stderr when mem_stats_file is empty
+  bool mem_stats{false};
+  std::string mem_stats_file;
+
+  // Chrome trace-event file of the same intervals (--trace=file)
+  std::string trace_file;
+};
+
+}  // namespace deviant
+
+#endif  // __OPTIONS_H__
@@ -0,0 +1,61 @@
+#ifndef __OUTPUT_FILE_H__
+#define __OUTPUT_FILE_H__
+
+#include <string>
+#include <thread>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+// machine code or bitcode of one module, kept in memory
+using CodeBuffer = llvm::SmallVector<char, 0>;
+
+// Output file written in one go. Serializers print into an in-memory buffer
+// through stream(); commit() then hands the buffer to a background thread
+// that writes it with a single write() while the compiler tears down the
+// module. The file is opened up front so that a bad path is reported
+// before any work is spent on it.
+class OutputFile {
+ public:
+  OutputFile() : stream_(buffer_) {}
+  ~OutputFile();
+
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  // return true if filename could be created
+  [[nodiscard]] bool open(const std::string& filename);
+
+  llvm::raw_pwrite_stream& stream() { return stream_; }
+
+  // start writing the buffer in the background
+  void commit();
+
+  // wait for the writer; return true if everything reached the file
+  [[nodiscard]] bool wait();
+
+ private:
+  void write();
+
+  std::string filename_;
+  int fd_{-1};
+  bool ok_{false};
+
+  llvm::SmallVector<char, 0> buffer_;
+  llvm::raw_svector_ostream stream_;
+  std::thread writer_;
+};
+
+}  // namespace deviant
+
+#endif  // __OUTPUT_FILE_H__
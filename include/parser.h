@@ -2,43 +2,94 @@
 #define __PARSER_H__
 
 #include <map>
+#include <ostream>
+#include <string_view>
 
+#include "arena.h"
 #include "ast.h"
+#include "interner.h"
 #include "lexer.h"
 #include "token.h"
 
 namespace deviant {
 class Parser {
  public:
-  Parser(const std::string& content) : lexer_(content), index_(0) {
-    lexer_.tokenize();
-  }
+  // tokens are pulled from the lexer's stream while parsing; AST nodes are
+  // allocated from arena and names interned into interner, both of which
+  // must outlive the returned tree
+  Parser(std::string_view content, Arena& arena, Interner& interner)
+      : lexer_(content, interner), arena_(arena), index_(0) {}
 
   // parse whole program
-  std::unique_ptr<Program> parse();
+  Program* parse();
+
+  // tokens read by parse()
+  size_t tokens() const { return lexer_.scanned(); }
+
+  // errors reported by parse(); the tree is incomplete if there are any
+  size_t errors() const { return errors_; }
 
  private:
   // TODO: lots of things...
-  std::unique_ptr<Expression> parseExpression();
-  std::unique_ptr<Statement> parseTopLevelStatement();
-  std::unique_ptr<Statement> parseStatement();
-  std::unique_ptr<Identifier> parseIdentifier();
-  std::unique_ptr<VariableDeclaration> parseVariableDeclaration();
-  std::unique_ptr<Assignment> parseAssignment();
-  std::unique_ptr<FunctionStatement> parseFunctionStatement();
-  std::unique_ptr<FunctionCall> parseFunctionCall();
-  std::unique_ptr<ReturnStatement> parseReturnStatement();
-  std::unique_ptr<ComparationOp> parseInfixStatement();
-  std::unique_ptr<IfStatement> parseIfStatement();
-  std::unique_ptr<Block> parseBlock();
-
-  [[nodicard]] std::optional<Token> peek(int offset = 0) const;
-
-  const Token& consume();
+
+  // Expressions are parsed by precedence climbing: an operand, then every
+  // following binary operator that binds tighter than min_precedence
+  // together with its right operand. Like the other parse functions they
+  // start at the first token and stop on the last one of what they parse.
+  Expression* parseExpression(int min_precedence = 0);
+  Expression* parsePrefixExpression();
+  // the int or float literal at the current token, negated if it follows a
+  // minus so that -2147483648 is in range; null with an error if it is not
+  Expression* parseLiteral(bool negative);
+  Expression* parseInfixExpression(Expression* lhs);
+  // base[index]
+  Expression* parseSubscript(Expression* base);
+  // a builtin on vectors and its arguments, see VectorOp
+  VectorOp* parseVectorOp(VectorOp::VecOp op, ValueType type);
+  Statement* parseTopLevelStatement();
+  Statement* parseStatement();
+  Identifier* parseIdentifier();
+  VariableDeclaration* parseVariableDeclaration();
+  Assignment* parseAssignment();
+  // name[index] = value
+  Assignment* parseElementAssignment();
+  // var name[length] and its values, on the stack or global
+  ArrayDeclaration* parseArrayDeclaration(bool global);
+  // [inline|noinline] [export] fn name(a: type, ...) -> type { body }
+  FunctionStatement* parseFunctionStatement();
+  FunctionCall* parseFunctionCall();
+  // ret value; or ret tail f(...);
+  ReturnStatement* parseReturnStatement();
+  IfStatement* parseIfStatement();
+  LoopStatement* parseWhileStatement();
+  LoopStatement* parseForStatement();
+  // an annotation and the statement it applies to: @likely or @unlikely
+  // before an if, @unroll(N), @vectorize or @novectorize before a loop
+  Statement* parseAnnotatedStatement();
+  Block* parseBlock();
+
+  // type of the token at index_ + offset, ILLEGAL when out of range
+  [[nodiscard]] TokenType peek(int offset = 0);
+
+  // source text of the token at index_ + offset, empty when out of range
+  [[nodiscard]] std::string_view peekText(int offset = 0);
+
+  // interned name of the identifier at index_ + offset, kNoSymbol otherwise
+  [[nodiscard]] Symbol peekSymbol(int offset = 0);
+
+  TokenType consume();
+
+  // print "Deviant Error: " and return the stream for the rest of the
+  // message
+  std::ostream& error();
 
   Lexer lexer_;
 
+  Arena& arena_;
+
   size_t index_;
+
+  size_t errors_{0};
 };
 
 }  // namespace deviant
@@ -0,0 +1,103 @@
+#ifndef __SCOPE_TABLE_H__
+#define __SCOPE_TABLE_H__
+
+#include <cstddef>
+#include <vector>
+
+#include "interner.h"
+
+namespace deviant {
+
+// Bindings of all open scopes in a single open-addressing (linear probing)
+// table keyed by Symbol. Binding a name pushes its previous value on an undo
+// log; leaving a scope replays the log back to the scope's marker. Lookup is
+// one probe sequence whatever the nesting depth, and scopes cost no
+// allocation of their own.
+//
+// Entries are never removed: a key whose binding is undone keeps its slot
+// with a null value, so the table only grows with the number of distinct
+// names bound during a compilation.
+template <typename T>
+class ScopeTable {
+ public:
+  ScopeTable() : slots_(kInitialCapacity) {}
+
+  // innermost binding of symbol, nullptr if there is none
+  T* find(Symbol symbol) const {
+    const Slot& slot = slots_[probe(symbol)];
+    return slot.key == symbol ? slot.value : nullptr;
+  }
+
+  // bind symbol in the innermost scope, shadowing outer bindings
+  void bind(Symbol symbol, T* value) {
+    Slot* slot = &slots_[probe(symbol)];
+    if (slot->key != symbol) {
+      if ((used_ + 1) * 2 > slots_.size()) {
+        grow();
+        slot = &slots_[probe(symbol)];
+      }
+      slot->key = symbol;
+      ++used_;
+    }
+    undo_.push_back({symbol, slot->value});
+    slot->value = value;
+  }
+
+  void enterScope() { marks_.push_back(undo_.size()); }
+
+  // restore every binding made since the matching enterScope()
+  void exitScope() {
+    const size_t mark = marks_.back();
+    marks_.pop_back();
+    while (undo_.size() > mark) {
+      const Undo& undo = undo_.back();
+      slots_[probe(undo.symbol)].value = undo.previous;
+      undo_.pop_back();
+    }
+  }
+
+  size_t depth() const { return marks_.size(); }
+
+ private:
+  static constexpr size_t kInitialCapacity = 64;  // power of two
+
+  struct Slot {
+    Symbol key{kNoSymbol};
+    T* value{nullptr};
+  };
+
+  struct Undo {
+    Symbol symbol;
+    T* previous;
+  };
+
+  // slot holding symbol, or the empty slot where it would go
+  size_t probe(Symbol symbol) const {
+    const size_t mask = slots_.size() - 1;
+    // symbols are dense ids, so their low bits already spread well
+    size_t i = symbol & mask;
+    while (slots_[i].key != symbol && slots_[i].key != kNoSymbol) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void grow() {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    for (const Slot& slot : old) {
+      if (slot.key != kNoSymbol) {
+        slots_[probe(slot.key)] = slot;
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t used_{0};
+  std::vector<Undo> undo_;
+  std::vector<size_t> marks_;  // undo_ size at each enterScope()
+};
+
+}  // namespace deviant
+
+#endif  // __SCOPE_TABLE_H__
@@ -0,0 +1,38 @@
+#ifndef __SOURCE_BUFFER_H__
+#define __SOURCE_BUFFER_H__
+
+#include <string>
+#include <string_view>
+
+namespace deviant {
+
+// Read-only view of a source file. Regular files are memory mapped
+// (MAP_PRIVATE, MADV_SEQUENTIAL) so the lexer scans the page cache directly;
+// pipes, stdin ("-") and platforms without mmap fall back to read().
+class SourceBuffer {
+ public:
+  SourceBuffer() = default;
+  ~SourceBuffer();
+
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+  // return true if the whole file is available through view()
+  [[nodiscard]] bool load(const std::string& filename);
+
+  std::string_view view() const { return std::string_view(data_, size_); }
+
+ private:
+  void unmap();
+
+  const char* data_{nullptr};
+  size_t size_{0};
+  bool mapped_{false};
+
+  // owns the bytes when the file could not be mapped
+  std::string fallback_;
+};
+
+}  // namespace deviant
+
+#endif  // __SOURCE_BUFFER_H__
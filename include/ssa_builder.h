@@ -0,0 +1,86 @@
+#ifndef __SSA_BUILDER_H__
+#define __SSA_BUILDER_H__
+
+#include <string_view>
+#include <utility>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "interner.h"
+
+namespace deviant {
+
+// A local variable. Every declaration is a variable of its own, so a
+// shadowing declaration never sees the definitions of the one it hides.
+struct Variable {
+  Symbol symbol;
+  std::string_view name;
+  llvm::Type* type;
+  // storage: a stack slot, null when built in SSA form; a stack slot or
+  // global for arrays, whose type is an llvm::ArrayType
+  llvm::Value* slot;
+};
+
+// SSA construction while the IR is generated, after Braun et al., "Simple
+// and Efficient Construction of Static Single Assignment Form" (CC 2013).
+// Assignments record the current definition of a variable per block;
+// reads look it up, walking to the predecessors and placing phi nodes where
+// several definitions meet. A block is sealed once all its predecessors are
+// known; until then reads in it get operand-less phis that are completed
+// on seal(). Phis whose operands all turn out to be one value are removed
+// again, so code without loops or joins gets no phis at all.
+class SsaBuilder {
+ public:
+  void write(Variable* var, llvm::BasicBlock* block, llvm::Value* value) {
+    defs_[{var, block}] = value;
+  }
+
+  llvm::Value* read(Variable* var, llvm::BasicBlock* block) {
+    auto it = defs_.find({var, block});
+    if (it != defs_.end() && it->second)
+      return it->second;
+    return readRecursive(var, block);
+  }
+
+  // no predecessors will be added to block any more
+  void seal(llvm::BasicBlock* block);
+
+  // forget everything, between functions
+  void clear();
+
+  // phi nodes placed and kept since the last clear()
+  size_t phis() const { return created_ - removed_; }
+
+ private:
+  llvm::Value* readRecursive(Variable* var, llvm::BasicBlock* block);
+  llvm::PHINode* createPhi(Variable* var, llvm::BasicBlock* block);
+  llvm::Value* addOperands(Variable* var, llvm::PHINode* phi);
+  llvm::Value* tryRemoveTrivial(llvm::PHINode* phi);
+
+  // handles follow replaceAllUsesWith, so removing a trivial phi updates
+  // the definitions that refer to it
+  llvm::DenseMap<std::pair<Variable*, llvm::BasicBlock*>, llvm::WeakTrackingVH>
+      defs_;
+  llvm::SmallPtrSet<llvm::BasicBlock*, 16> sealed_;
+  llvm::DenseMap<llvm::BasicBlock*,
+                 llvm::SmallVector<std::pair<Variable*, llvm::PHINode*>, 4>>
+      incomplete_;
+  size_t created_{0};
+  size_t removed_{0};
+};
+
+}  // namespace deviant
+
+#endif  // __SSA_BUILDER_H__
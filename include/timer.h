@@ -0,0 +1,160 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Support/raw_ostream.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+// Process-wide collector of timed intervals for --time-report and --trace.
+// It stays disabled unless one of the flags, or --mem-stats, is given; until
+// then a ScopedTimer costs one load and a predictable branch, and nothing is
+// recorded. Intervals may be recorded from any thread.
+class Profiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // scoped timers are active
+  static bool enabled() { return enabled_; }
+
+  // intervals are recorded
+  static bool timing() { return timing_; }
+
+  // start collecting; timestamps are relative to this call
+  static void enable();
+
+  // let the main thread's "phase" scopes delimit MemStats phases
+  static void enableMemory();
+
+  static Profiler& get();
+
+  // category groups the entries of the report, e.g. "phase", "function" or
+  // "pass"; name is copied. Sums of many intervals are reported but left
+  // out of the trace, where they would not line up with anything.
+  void record(const char* category, std::string_view name,
+              Clock::time_point start, Clock::time_point end,
+              bool in_trace = true);
+
+  // called by ScopedTimer
+  void beginScope(const char* category, std::string_view name);
+  void endScope(const char* category, std::string_view name,
+                Clock::time_point start, Clock::time_point end);
+
+  // inclusive time per category and name, slowest first
+  void printReport(llvm::raw_ostream& os);
+
+  // write the intervals in Chrome trace-event format (chrome://tracing,
+  // ui.perfetto.dev); return false if the file could not be written
+  bool writeTrace(const std::string& filename);
+
+ private:
+  struct Event {
+    const char* category;
+    std::string name;
+    int64_t start_us;
+    int64_t duration_us;
+    uint32_t thread;
+    bool in_trace;
+  };
+
+  static inline bool enabled_{false};
+  static inline bool timing_{false};
+  static inline bool memory_{false};
+
+  Clock::time_point origin_;
+  std::thread::id main_thread_;
+  std::mutex mutex_;
+  std::vector<Event> events_;
+};
+
+// Times the enclosing scope. name must stay alive as long as the timer.
+class ScopedTimer {
+ public:
+  ScopedTimer(const char* category, std::string_view name) {
+    if (Profiler::enabled()) {
+      category_ = category;
+      name_ = name;
+      Profiler::get().beginScope(category, name);
+      start_ = Profiler::Clock::now();
+    }
+  }
+
+  ~ScopedTimer() {
+    if (category_) {
+      Profiler::get().endScope(category_, name_, start_,
+                               Profiler::Clock::now());
+    }
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  const char* category_{nullptr};
+  std::string_view name_;
+  Profiler::Clock::time_point start_;
+};
+
+// Sums many intervals too short to be recorded one by one, like scanning a
+// single token, and records the sum as one entry on flush().
+class TimeAccumulator {
+ public:
+  TimeAccumulator(const char* category, std::string_view name)
+      : category_(category), name_(name) {}
+
+  class Scope {
+   public:
+    explicit Scope(TimeAccumulator& accumulator) {
+      if (Profiler::timing()) {
+        accumulator_ = &accumulator;
+        start_ = Profiler::Clock::now();
+      }
+    }
+
+    ~Scope() {
+      if (accumulator_) {
+        accumulator_->total_ += Profiler::Clock::now() - start_;
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    TimeAccumulator* accumulator_{nullptr};
+    Profiler::Clock::time_point start_;
+  };
+
+  void flush() {
+    if (Profiler::timing() && total_.count() > 0) {
+      auto end = Profiler::Clock::now();
+      Profiler::get().record(category_, name_, end - total_, end,
+                             /*in_trace=*/false);
+    }
+    total_ = {};
+  }
+
+ private:
+  const char* category_;
+  std::string_view name_;
+  Profiler::Clock::duration total_{};
+};
+
+}  // namespace deviant
+
+#endif  // __TIMER_H__
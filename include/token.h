@@ -1,21 +1,37 @@
 #ifndef __TOKEN_H__
 #define __TOKEN_H__
 
+#include <cstdint>
+
+#include "interner.h"
+
 namespace deviant {
-enum class TokenType {
+enum class TokenType : uint8_t {
   ILLEGAL,
   RETURN,
+  TAIL,
   INT_LIT,
+  FLOAT_LIT,
   INT,
+  FLOAT,
+  I32X4,
+  I32X8,
+  F32X8,
   FN,
   FN_TYPE,
+  INLINE,
+  NOINLINE,
+  EXPORT,
   VAR,
   IF,
   ELSE,
+  WHILE,
+  FOR,
   IDENTIFIER,
   OPEN_PAREN,
   CLOSE_PAREN,
   COMMA,
+  COLON,
   SEMICOLON,
   ASSIGNMENT,
   PLUS,
@@ -29,15 +45,32 @@ enum class TokenType {
   EQ,
   NE,
   EXCLAMATION,
+  AT,  // @ of annotations like @likely
   OPEN_CURLY,
-  CLOSE_CURLY
+  CLOSE_CURLY,
+  OPEN_BRACKET,
+  CLOSE_BRACKET
 };
 
+// A token is only a kind plus a slice [offset, offset + length) of the
+// lexer's source buffer; the text itself is never copied. Identifiers also
+// carry their interned symbol.
 struct Token {
-  TokenType type;
-  std::optional<std::string> value;
+  uint32_t offset;
+  uint32_t length : 24;
+  uint32_t kind : 8;  // TokenType
+  Symbol symbol;
+
+  TokenType type() const { return static_cast<TokenType>(kind); }
+  void setType(TokenType type) { kind = static_cast<uint32_t>(type); }
 };
 
+constexpr uint32_t kMaxTokenLength = (1u << 24) - 1;
+// so that every offset fits; the lexer rejects larger sources
+constexpr uint64_t kMaxSourceSize = (uint64_t(1) << 32) - 1;
+
+static_assert(sizeof(Token) <= 12, "Token should stay compact");
+
 }  // namespace deviant
 
 #endif  // __TOKEN_H__
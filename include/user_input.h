@@ -3,6 +3,8 @@
 
 #include <iostream>
 
+#include "options.h"
+
 namespace deviant {
 
 class UserInput {
@@ -12,8 +14,13 @@ class UserInput {
   
   const std::string& getFilename() { return filename_; }
 
+  bool isVerbose() const { return options_.verbose; }
+
+  const CompileOptions& getOptions() const { return options_; }
+
  private:
   std::string filename_;
+  CompileOptions options_;
 };
 
 }  // namespace deviant
@@ -1,22 +1,12 @@
-#include <fstream>
+#include <iostream>
 #include <memory>
 #include <string>
 
 #include "deviant_llvm.h"
+#include "source_buffer.h"
+#include "timer.h"
 #include "user_input.h"
 
-std::string readFile(const std::string& fileName) {
-  std::ifstream ifs(fileName.c_str(), std::ios::in | std::ios::ate);
-
-  std::ifstream::pos_type fileSize = ifs.tellg();
-  ifs.seekg(0, std::ios::beg);
-
-  std::vector<char> bytes(fileSize);
-  ifs.read(bytes.data(), fileSize);
-
-  return std::string(bytes.data(), fileSize);
-}
-
 int main(int argc, char* argv[]) {
   deviant::UserInput user_input;
   bool handle_file = user_input.handleUserInput(argc, argv);
@@ -24,9 +14,53 @@ int main(int argc, char* argv[]) {
   if (!handle_file)
     return 1;
 
-  std::string program(readFile(user_input.getFilename()));
-  deviant::DeviantLLVM vm;
-  vm.execute(program);
+  const deviant::CompileOptions& options = user_input.getOptions();
+  if (options.time_report || !options.trace_file.empty())
+    deviant::Profiler::enable();
+  if (options.mem_stats)
+    deviant::Profiler::enableMemory();
+
+  // must outlive vm, whose parser scans the buffer in place
+  deviant::SourceBuffer source;
+  {
+    deviant::ScopedTimer timer("phase", "read source");
+    if (!source.load(user_input.getFilename())) {
+      std::cerr << "Deviant Error: cannot read " << user_input.getFilename()
+                << "\n";
+      return 1;
+    }
+  }
+
+  deviant::DeviantLLVM vm(options);
+  int status = vm.execute(source.view());
+  if (!vm.finish())
+    status = 1;
+
+  if (options.time_report)
+    deviant::Profiler::get().printReport(llvm::errs());
+  if (!options.trace_file.empty() &&
+      !deviant::Profiler::get().writeTrace(options.trace_file))
+    status = 1;
+  if (options.mem_stats) {
+    if (options.mem_stats_file.empty()) {
+      vm.printMemStats(llvm::errs());
+    } else {
+      std::error_code err_code;
+      llvm::raw_fd_ostream out(options.mem_stats_file, err_code);
+      if (err_code) {
+        std::cerr << "Deviant Error: cannot write " << options.mem_stats_file
+                  << "\n";
+        status = 1;
+      } else {
+        vm.printMemStats(out);
+      }
+    }
+  }
+
+  if (user_input.isVerbose()) {
+    vm.printArenaStats(llvm::errs());
+    vm.printBoundsCheckStats(llvm::errs());
+  }
 
-  return EXIT_SUCCESS;
+  return status;
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+/* Deviant runtime: support functions called by generated code. It is linked
+ * into every executable built with -o, and into the compiler itself so that
+ * `deviant run` resolves the same symbols from the host process. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* print(int) */
+int deviant_print_i32(int value) {
+  return printf("%d", value);
+}
+
+/* print(float) */
+int deviant_print_f32(float value) {
+  return printf("%g", value);
+}
+
+/* print(vector) prints its lanes one by one as <a, b, c, d> */
+int deviant_print_lane_i32(int value, int lane, int lanes) {
+  return printf("%s%d%s", lane == 0 ? "<" : ", ", value,
+                lane == lanes - 1 ? ">" : "");
+}
+
+int deviant_print_lane_f32(float value, int lane, int lanes) {
+  return printf("%s%g%s", lane == 0 ? "<" : ", ", value,
+                lane == lanes - 1 ? ">" : "");
+}
+
+/* a failed bounds check: a[index] of an array of length elements */
+void deviant_bounds_fail(int index, int length) {
+  fflush(stdout);
+  fprintf(stderr, "Deviant Error: index %d out of bounds of an array of %d\n",
+          index, length);
+  exit(1);
+}
@@ -0,0 +1,29 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace deviant {
+
+Arena::~Arena() {
+  for (char* block : blocks_) {
+    std::free(block);
+  }
+}
+
+void* Arena::grow(size_t bytes, size_t alignment) {
+  // oversized requests get a block of their own
+  const size_t size = std::max(block_size_, bytes + alignment);
+  char* block = static_cast<char*>(std::malloc(size));
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  blocks_.push_back(block);
+  bytes_reserved_ += size;
+
+  cur_ = block;
+  end_ = block + size;
+  return do_allocate(bytes, alignment);
+}
+
+}  // namespace deviant
@@ -1,11 +1,17 @@
 #include "ast.h"
 
+#include <bit>
+#include <limits>
+#include <optional>
+#include <string>
+
 #if defined(_MSC_VER)
 #pragma warning(push, 0)
 #endif
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 
@@ -13,18 +19,148 @@
 #pragma warning(pop)
 #endif
 
+#include "ast_hasher.h"
 #include "deviant_llvm.h"
+#include "timer.h"
 
 namespace deviant {
 llvm::Value* Program::generateCode(DeviantLLVM& context) {
-  llvm::Value* last = nullptr;
+  return generateCode(context, 0, statements_.size());
+}
+
+llvm::Value* Program::generateCode(DeviantLLVM& context, size_t first,
+                                   size_t last) {
+  // declare the functions and global arrays of the slice first, so uses
+  // resolve regardless of definition order; those outside the slice are
+  // only declared when a use needs them
   for (size_t i = 0; i < statements_.size(); ++i) {
-    auto stmt = statements_[i].get();
-    last = stmt->generateCode(context);
+    const bool in_slice = i >= first && i < last;
+    if (statements_[i]->type() == Type::FUNCTION) {
+      auto fn = static_cast<FunctionStatement*>(statements_[i]);
+      if (in_slice) {
+        fn->declare(context);
+      } else {
+        context.registerDeclaration(fn);
+      }
+    } else if (statements_[i]->type() == Type::ARRAY) {
+      auto array = static_cast<ArrayDeclaration*>(statements_[i]);
+      if (in_slice) {
+        array->declare(context);
+      } else {
+        context.registerGlobal(array);
+      }
+    }
   }
-  return last;
+
+  llvm::Value* value = nullptr;
+  for (size_t i = first; i < last; ++i) {
+    auto stmt = statements_[i];
+    value = stmt->generateCode(context);
+  }
+  return value;
+}
+
+void Program::declare(DeviantLLVM& context) {
+  for (auto stmt : statements_) {
+    if (stmt->type() == Type::FUNCTION) {
+      static_cast<FunctionStatement*>(stmt)->declare(context);
+    } else if (stmt->type() == Type::ARRAY) {
+      static_cast<ArrayDeclaration*>(stmt)->declare(context);
+    }
+  }
+}
+
+namespace {
+
+// type as spelled in Deviant, for error messages
+std::string typeName(llvm::Type* type) {
+  if (auto array = llvm::dyn_cast<llvm::ArrayType>(type)) {
+    return typeName(array->getElementType()) + "[" +
+           std::to_string(array->getNumElements()) + "]";
+  }
+  if (auto vector = llvm::dyn_cast<llvm::FixedVectorType>(type)) {
+    return (vector->getElementType()->isFloatTy() ? "f32x" : "i32x") +
+           std::to_string(vector->getNumElements());
+  }
+  return type->isFloatTy() ? "float" : "int";
+}
+
+// value as a value of type: ints convert to floats and scalars are splatted
+// into vectors; null with an error for anything else
+llvm::Value* convert(DeviantLLVM& context, llvm::Value* value,
+                     llvm::Type* type) {
+  if (value->getType() == type)
+    return value;
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  llvm::Type* element = type->getScalarType();
+  if (!value->getType()->isVectorTy()) {
+    if (value->getType()->isIntegerTy() && element->isFloatTy()) {
+      value = builder->CreateSIToFP(value, element);
+    }
+    if (value->getType() == element) {
+      if (auto vector = llvm::dyn_cast<llvm::FixedVectorType>(type))
+        return builder->CreateVectorSplat(vector->getNumElements(), value);
+      return value;
+    }
+  }
+  context.error() << typeName(value->getType()) << " used as " << typeName(type)
+                  << "\n";
+  return nullptr;
 }
 
+// index as a lane of a vector of type: checked if it is a constant,
+// wrapped around if not; null with an error when out of range
+llvm::Value* laneIndex(DeviantLLVM& context, llvm::FixedVectorType* type,
+                       llvm::Value* index) {
+  if (!index->getType()->isIntegerTy()) {
+    context.error() << "lane index of type " << typeName(index->getType())
+                    << "\n";
+    return nullptr;
+  }
+  const int64_t lanes = type->getNumElements();
+  if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(index)) {
+    const int64_t lane = constant->getSExtValue();
+    if (lane < 0 || lane >= lanes) {
+      context.error() << "lane " << lane << " out of range of "
+                      << typeName(type) << "\n";
+      return nullptr;
+    }
+    return index;
+  }
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  return builder->CreateURem(index, builder->getInt32(lanes));
+}
+
+// pointer to the element of array at index, after its bounds check
+llvm::Value* elementPointer(DeviantLLVM& context, Variable* array,
+                            Expression* index) {
+  llvm::Value* value = index->generateCode(context);
+  if (!value)
+    return nullptr;
+  if (!value->getType()->isIntegerTy()) {
+    context.error() << "index of type " << typeName(value->getType()) << "\n";
+    return nullptr;
+  }
+  auto type = llvm::cast<llvm::ArrayType>(array->type);
+  if (!context.checkBounds(value, type->getNumElements()))
+    return nullptr;
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  return builder->CreateInBoundsGEP(type, array->slot,
+                                    {builder->getInt32(0), value});
+}
+
+// the type both operands of a binary operation are converted to: a vector
+// if either is one, else float if either is one, else int
+llvm::Type* commonType(llvm::Type* lhs, llvm::Type* rhs) {
+  if (lhs->isVectorTy())
+    return lhs;
+  if (rhs->isVectorTy())
+    return rhs;
+  return lhs->isFloatTy() ? lhs : rhs;
+}
+
+}  // namespace
+
 llvm::Value* AstNode::generateCode(DeviantLLVM& context) {
   return llvm::ConstantInt::get(context.getGenericIntegerType(), 0, true);
 }
@@ -33,61 +169,122 @@ llvm::Value* Integer::generateCode(DeviantLLVM& context) {
   return llvm::ConstantInt::get(context.getGenericIntegerType(), value_, true);
 }
 
+llvm::Value* Decimal::generateCode(DeviantLLVM& context) {
+  return llvm::ConstantFP::get(context.getType(ValueType::FLOAT), value_);
+}
+
 llvm::Value* Identifier::generateCode(DeviantLLVM& context) {
-  // a usual stack variable
-  llvm::AllocaInst* alloc = context.findVariable(name_);
-  if (alloc != nullptr) {
-    return new llvm::LoadInst(alloc->getAllocatedType(), alloc, name_, false,
-                              context.currentBlock());
+  Variable* var = context.findVariable(name_);
+  if (var == nullptr) {
+    context.error() << context.getSymbolName(name_) << " is not declared\n";
+    return nullptr;
   }
-  return nullptr;
+  if (var->type->isArrayTy()) {
+    context.error() << "array " << var->name << " used as a value, index it\n";
+    return nullptr;
+  }
+  return context.readVariable(var);
 }
 
 llvm::Value* VariableDeclaration::generateCode(DeviantLLVM& context) {
+  // the variable has the type of its initial value, int without one
   llvm::Value* val = nullptr;
-
-  const std::string& var_name(identifier_->getName());
-
-  if (context.findVariable(var_name)) {  // already declard!
+  if (expr_) {
+    val = expr_->generateCode(context);
+    if (!val)
+      return nullptr;
+  }
+  Variable* var = context.declareVariable(
+      identifier_->getName(),
+      val ? val->getType() : context.getGenericIntegerType());
+  if (!var) {
+    context.error() << context.getSymbolName(identifier_->getName())
+                    << " is already declared\n";
     return nullptr;
   }
 
-  // TODO: understand
-  // context.locals()[identifier_->getName()] = nullptr;
-  val = new llvm::AllocaInst(context.getGenericIntegerType(), 0,
-                             identifier_->getName().c_str(),
-                             context.currentBlock());
-
-  // TODO: remove hardcode
-  auto alloca = static_cast<llvm::AllocaInst*>(val);
-  context.conductVar(var_name, alloca);
-
-  return val;
+  if (val) {
+    context.writeVariable(var, val);
+  }
+  // non-null for the callers checking for errors
+  return llvm::UndefValue::get(var->type);
 }
 
 llvm::Value* Assignment::generateCode(DeviantLLVM& context) {
-  // TODO:
-  llvm::AllocaInst* alloc = context.findVariable(var_name_);
-  if (alloc) {
+  Variable* var = context.findVariable(var_name_);
+  if (!var) {
+    context.error() << context.getSymbolName(var_name_) << " is not declared\n";
+    return nullptr;
+  }
+
+  if (var->type->isArrayTy()) {
+    if (!index_) {
+      context.error() << "array " << var->name
+                      << " assigned as a whole, assign its elements\n";
+      return nullptr;
+    }
+    llvm::Value* ptr = elementPointer(context, var, index_);
+    if (!ptr)
+      return nullptr;
     llvm::Value* val = expr_->generateCode(context);
-    return new llvm::StoreInst(val, alloc, false, context.currentBlock());
-  } else {  // not declare yet
+    if (!val)
+      return nullptr;
+    val = convert(context, val, var->type->getArrayElementType());
+    if (!val)
+      return nullptr;
+    context.getBuilder()->CreateStore(val, ptr);
+    return val;
+  }
+
+  llvm::Value* lane = nullptr;
+  if (index_) {  // a lane of a vector
+    auto type = llvm::dyn_cast<llvm::FixedVectorType>(var->type);
+    if (!type) {
+      context.error() << typeName(var->type) << " cannot be indexed\n";
+      return nullptr;
+    }
+    lane = index_->generateCode(context);
+    if (!lane)
+      return nullptr;
+    lane = laneIndex(context, type, lane);
+    if (!lane)
+      return nullptr;
+  }
+  llvm::Value* val = expr_->generateCode(context);
+  if (!val)
+    return nullptr;
+  val = convert(context, val, lane ? var->type->getScalarType() : var->type);
+  if (!val)
     return nullptr;
+  if (lane) {
+    val = context.getBuilder()->CreateInsertElement(context.readVariable(var),
+                                                    val, lane);
   }
+  context.writeVariable(var, val);
+  return val;
 }
 
 llvm::Value* Block::generateCode(DeviantLLVM& context) {
   llvm::Value* last = nullptr;
   for (size_t i = 0; i < statements_.size(); ++i) {
-    auto stmt = statements_[i].get();
+    // statements after a ret are dead
+    if (context.currentBlock()->getTerminator())
+      break;
+    auto stmt = statements_[i];
     last = stmt->generateCode(context);
   }
   return last;
 }
 
 llvm::Value* ReturnStatement::generateCode(DeviantLLVM& context) {
+  if (tail_)
+    return generateTailCall(context);
   if (ret_expr_) {
     llvm::Value* ret = ret_expr_->generateCode(context);
+    if (ret == nullptr)
+      return nullptr;
+    ret = convert(context, ret,
+                  context.currentBlock()->getParent()->getReturnType());
     if (ret == nullptr)
       return nullptr;
     return context.getBuilder()->CreateRet(ret);
@@ -96,35 +293,140 @@ llvm::Value* ReturnStatement::generateCode(DeviantLLVM& context) {
   }
 }
 
-llvm::Value* FunctionStatement::generateCode(DeviantLLVM& context) {
-  auto fn = context.getModule()->getFunction(fn_name_);
+llvm::Value* ReturnStatement::generateTailCall(DeviantLLVM& context) {
+  // the parser only takes a call after ret tail
+  auto call_expr = static_cast<FunctionCall*>(ret_expr_);
+  llvm::Function* caller = context.currentBlock()->getParent();
+  llvm::Function* callee = context.getFunction(call_expr->getName());
+  if (!callee) {
+    context.error() << "ret tail in " << caller->getName()
+                    << " takes a call of a function of the program\n";
+    return nullptr;
+  }
 
-  // TODO: remove hardcode
-  auto fn_type = llvm::FunctionType::get(/*return type*/
-                                         context.getBuilder()->getInt32Ty(),
-                                         /*vararg*/ false);
+  // musttail passes the arguments in the caller's own incoming slots, so
+  // both sides must agree on them and on who cleans up
+  const char* reason = nullptr;
+  if (callee->getFunctionType() != caller->getFunctionType()) {
+    reason = "their parameter or return types differ";
+  } else if (callee->getCallingConv() != caller->getCallingConv()) {
+    reason = "their calling conventions differ (main and export functions "
+             "use the C convention)";
+  }
+  if (reason) {
+    context.error() << "cannot tail call " << callee->getName() << " from "
+                    << caller->getName() << ": " << reason << "\n";
+    return nullptr;
+  }
 
-  // if not, allocate the function
-  if (!fn) {
-    fn = llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage,
-                                fn_name_, *context.getModule());
-    verifyFunction(*fn);
+  auto call = llvm::dyn_cast_or_null<llvm::CallInst>(
+      call_expr->generateCode(context));
+  if (!call)
+    return nullptr;
+  call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  return context.getBuilder()->CreateRet(call);
+}
+
+void FunctionStatement::declare(DeviantLLVM& context) {
+  if (context.getFunction(fn_name_))
+    return;
+
+  std::vector<llvm::Type*> params;
+  params.reserve(params_.size());
+  for (const Parameter& param : params_) {
+    params.push_back(context.getType(param.type));
   }
+  auto fn_type = llvm::FunctionType::get(context.getType(return_type_),
+                                         params, /*vararg*/ false);
+
+  const std::string_view name = context.getSymbolName(fn_name_);
+  auto fn = llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage,
+                                   name, *context.getModule());
+  for (size_t i = 0; i < params_.size(); ++i) {
+    fn->getArg(i)->setName(context.getSymbolName(params_[i].name));
+  }
+  if (!exported_ && name != "main") {
+    context.makeInternal(fn);
+  }
+  if (inlining_ == Inlining::ALWAYS) {
+    fn->addFnAttr(llvm::Attribute::AlwaysInline);
+  } else if (inlining_ == Inlining::NEVER) {
+    fn->addFnAttr(llvm::Attribute::NoInline);
+  }
+  context.registerFunction(fn_name_, fn);
+}
+
+llvm::Value* FunctionStatement::generateCode(DeviantLLVM& context) {
+  ScopedTimer timer("function", context.getSymbolName(fn_name_));
+  // called as int main() by the JIT and the C runtime
+  if (context.getSymbolName(fn_name_) == "main" &&
+      (!params_.empty() || return_type_ != ValueType::INT)) {
+    context.error() << "main takes no parameters and returns " "int\n";
+    return nullptr;
+  }
+  declare(context);
+  auto fn = context.getFunction(fn_name_);
 
   // createFunctionBlock(fn);
   auto entry =
       llvm::BasicBlock::Create(context.getGlobalContext(), "entry", fn);
-  context.getBuilder()->SetInsertPoint(entry);
-
   context.newScope(entry);
+  context.sealBlock(entry);
+
+  // parameters are variables holding the arguments
+  for (size_t i = 0; i < params_.size(); ++i) {
+    llvm::Argument* arg = fn->getArg(i);
+    Variable* var = context.declareVariable(params_[i].name, arg->getType());
+    if (!var) {
+      context.error() << "parameter " << context.getSymbolName(params_[i].name)
+                      << " declared twice\n";
+      context.endScope();
+      return nullptr;
+    }
+    context.writeVariable(var, arg);
+  }
 
   body_->generateCode(context);
 
+  // falling off the end returns 0
+  if (!context.currentBlock()->getTerminator()) {
+    context.getBuilder()->CreateRet(
+        llvm::Constant::getNullValue(fn->getReturnType()));
+  }
+  context.eliminateBoundsChecks(*fn);
+
   context.endScope();
 
   return fn;
 }
 
+namespace {
+
+// print(value), implemented by the runtime; vectors are printed lane by lane
+llvm::Value* generatePrint(DeviantLLVM& context, llvm::Value* value) {
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  auto vector = llvm::dyn_cast<llvm::FixedVectorType>(value->getType());
+  if (!vector) {
+    return builder->CreateCall(context.getPrintFunction(value->getType()),
+                               {value}, "printCall");
+  }
+
+  llvm::Function* print_lane =
+      context.getPrintLaneFunction(vector->getElementType());
+  const unsigned lanes = vector->getNumElements();
+  llvm::Value* printed = nullptr;
+  for (unsigned lane = 0; lane < lanes; ++lane) {
+    printed = builder->CreateCall(
+        print_lane,
+        {builder->CreateExtractElement(value, lane), builder->getInt32(lane),
+         builder->getInt32(lanes)},
+        "printCall");
+  }
+  return printed;
+}
+
+}  // namespace
+
 llvm::Value* FunctionCall::generateCode(DeviantLLVM& context) {
   // args
   std::vector<llvm::Value*> args;
@@ -133,73 +435,836 @@ llvm::Value* FunctionCall::generateCode(DeviantLLVM& context) {
     args.push_back(args_[i]->generateCode(context));
   }
 
-  // printf
-  if (fn_name_ == "print") {
-    args.push_back(args[0]);
-    llvm::Value* str = context.getBuilder()->CreateGlobalStringPtr("%d");
-    args[0] = str;
-    return context.getBuilder()->CreateCall(
-        context.getModule()->getFunction("printf"), args, "printfCall");
+  if (fn_name_ == context.getPrintSymbol()) {
+    if (args.size() != 1) {
+      context.error() << "print takes one value\n";
+      return nullptr;
+    }
+    if (!args[0])
+      return nullptr;
+    return generatePrint(context, args[0]);
+  }
+
+  llvm::Function* callee = context.getFunction(fn_name_);
+  if (!callee) {
+    context.error() << context.getSymbolName(fn_name_) << " is not declared\n";
+    return nullptr;
+  }
+  if (args.size() != callee->arg_size()) {
+    context.error() << callee->getName() << " takes " << callee->arg_size()
+                    << " arguments, " << args.size() << " given\n";
+    return nullptr;
+  }
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (!args[i])
+      return nullptr;
+    args[i] = convert(context, args[i], callee->getArg(i)->getType());
+    if (!args[i])
+      return nullptr;
+  }
+  llvm::CallInst* call = context.getBuilder()->CreateCall(callee, args);
+  call->setCallingConv(callee->getCallingConv());
+  return call;
+}
+
+namespace {
+
+Integer* asInteger(Expression* expr) {
+  return expr->type() == AstNode::Type::INTEGER ? static_cast<Integer*>(expr)
+                                                : nullptr;
+}
+
+// two's complement wrap-around, as the generated code behaves
+int wrap(int64_t value) {
+  return static_cast<int>(static_cast<uint32_t>(value));
+}
+
+// lhs op rhs, unless it would trap at run time
+std::optional<int> evaluate(int lhs, ArithmeticOp::ArithOp op, int rhs) {
+  switch (op) {
+    case ArithmeticOp::ADD:
+      return wrap(int64_t(lhs) + rhs);
+    case ArithmeticOp::SUB:
+      return wrap(int64_t(lhs) - rhs);
+    case ArithmeticOp::MUL:
+      return wrap(int64_t(lhs) * rhs);
+    default:
+      if (rhs == 0 || (lhs == std::numeric_limits<int>::min() && rhs == -1))
+        return std::nullopt;
+      return lhs / rhs;
+  }
+}
+
+bool evaluate(int lhs, ComparationOp::CompOp op, int rhs) {
+  switch (op) {
+    case ComparationOp::LT:
+      return lhs < rhs;
+    case ComparationOp::LE:
+      return lhs <= rhs;
+    case ComparationOp::GT:
+      return lhs > rhs;
+    case ComparationOp::GE:
+      return lhs >= rhs;
+    case ComparationOp::EQ:
+      return lhs == rhs;
+    default:
+      return lhs != rhs;
+  }
+}
+
+
+// lhs op rhs, converted to their common type
+llvm::Value* generateOperation(DeviantLLVM& context, llvm::Value* lhs,
+                               ArithmeticOp::ArithOp op, llvm::Value* rhs) {
+  llvm::Type* type = commonType(lhs->getType(), rhs->getType());
+  lhs = convert(context, lhs, type);
+  rhs = convert(context, rhs, type);
+  if (!lhs || !rhs)
+    return nullptr;
+
+  const bool is_float = type->getScalarType()->isFloatTy();
+  llvm::Instruction::BinaryOps opcode;
+  switch (op) {
+    case ArithmeticOp::ADD:
+      opcode = is_float ? llvm::Instruction::FAdd : llvm::Instruction::Add;
+      break;
+    case ArithmeticOp::SUB:
+      opcode = is_float ? llvm::Instruction::FSub : llvm::Instruction::Sub;
+      break;
+    case ArithmeticOp::MUL:
+      opcode = is_float ? llvm::Instruction::FMul : llvm::Instruction::Mul;
+      break;
+    default:
+      opcode = is_float ? llvm::Instruction::FDiv : llvm::Instruction::SDiv;
+      break;
+  }
+  return llvm::BinaryOperator::Create(opcode, lhs, rhs, "",
+                                      context.currentBlock());
+}
+
+}  // namespace
+
+llvm::Value* ArithmeticOp::generateCode(DeviantLLVM& context) {
+  if (!asInteger(rhs_) || op_ == DIV) {
+    llvm::Value* lhs = lhs_->generateCode(context);
+    llvm::Value* rhs = rhs_->generateCode(context);
+    if (!lhs || !rhs)
+      return nullptr;
+    return generateOperation(context, lhs, op_, rhs);
+  }
+
+  // (((x op c1) op c2) ...) op c, where the ops are all additions and
+  // subtractions or all multiplications; x is generated once
+  const bool additive = op_ != MUL;
+  std::vector<ArithmeticOp*> chain{this};
+  while (chain.back()->lhs_->type() == Type::ARITHMETIC) {
+    auto inner = static_cast<ArithmeticOp*>(chain.back()->lhs_);
+    if (!asInteger(inner->rhs_) || inner->op_ == DIV ||
+        (inner->op_ != MUL) != additive)
+      break;
+    chain.push_back(inner);
+  }
+  llvm::Value* value = chain.back()->lhs_->generateCode(context);
+  if (!value)
+    return nullptr;
+
+  // ints wrap, so their constants combine exactly; floats round after
+  // every step and get them one by one
+  if (value->getType()->getScalarType()->isIntegerTy()) {
+    int combined = additive ? 0 : 1;
+    for (ArithmeticOp* step : chain) {
+      combined = *evaluate(combined, step->op_,
+                           asInteger(step->rhs_)->getValue());
+    }
+    if (combined == (additive ? 0 : 1))
+      return value;
+    return generateOperation(
+        context, value, additive ? ADD : MUL,
+        llvm::ConstantInt::get(context.getGenericIntegerType(), combined,
+                               true));
+  }
+  for (auto step = chain.rbegin(); step != chain.rend() && value; ++step) {
+    value = generateOperation(context, value, (*step)->op_,
+                              (*step)->rhs_->generateCode(context));
   }
+  return value;
+}
 
-  return context.getBuilder()->CreateCall(
-      context.getModule()->getFunction(fn_name_), args);
+llvm::Value* Negation::generateCode(DeviantLLVM& context) {
+  llvm::Value* value = operand_->generateCode(context);
+  if (!value)
+    return nullptr;
+  if (value->getType()->getScalarType()->isFloatTy())
+    return llvm::UnaryOperator::CreateFNeg(value, "", context.currentBlock());
+  return llvm::BinaryOperator::CreateNeg(value, "", context.currentBlock());
 }
 
+llvm::Value* Expression::generateCondition(DeviantLLVM& context) {
+  llvm::Value* value = generateCode(context);
+  if (!value)
+    return nullptr;
+  if (value->getType()->isVectorTy()) {
+    context.error() << typeName(value->getType()) << " used as a condition\n";
+    return nullptr;
+  }
+  if (value->getType()->isFloatTy()) {
+    return new llvm::FCmpInst(*context.currentBlock(), llvm::CmpInst::FCMP_UNE,
+                              value,
+                              llvm::ConstantFP::get(value->getType(), 0.0));
+  }
+  return new llvm::ICmpInst(*context.currentBlock(), llvm::CmpInst::ICMP_NE,
+                            value, llvm::ConstantInt::get(value->getType(), 0));
+}
+
+llvm::Value* ComparationOp::generateCode(DeviantLLVM& context) {
+  llvm::Value* cmp = generateCondition(context);
+  if (!cmp)
+    return nullptr;
+  // an int like every other value
+  return new llvm::ZExtInst(cmp, context.getGenericIntegerType(), "",
+                            context.currentBlock());
+}
+
+llvm::Value* ComparationOp::generateCondition(DeviantLLVM& context) {
+  llvm::Value* lhs = lhs_->generateCode(context);
+  llvm::Value* rhs = rhs_->generateCode(context);
+  if (!lhs || !rhs)
+    return nullptr;
+  llvm::Type* type = commonType(lhs->getType(), rhs->getType());
+  if (type->isVectorTy()) {
+    context.error() << typeName(type)
+                    << " cannot be compared, compare its lanes\n";
+    return nullptr;
+  }
+  lhs = convert(context, lhs, type);
+  rhs = convert(context, rhs, type);
+  if (!lhs || !rhs)
+    return nullptr;
+
+  const bool is_float = type->isFloatTy();
+  llvm::CmpInst::Predicate predicate;
+  switch (op_) {
+    case LT:
+      predicate = is_float ? llvm::CmpInst::FCMP_OLT : llvm::CmpInst::ICMP_SLT;
+      break;
+    case LE:
+      predicate = is_float ? llvm::CmpInst::FCMP_OLE : llvm::CmpInst::ICMP_SLE;
+      break;
+    case GT:
+      predicate = is_float ? llvm::CmpInst::FCMP_OGT : llvm::CmpInst::ICMP_SGT;
+      break;
+    case GE:
+      predicate = is_float ? llvm::CmpInst::FCMP_OGE : llvm::CmpInst::ICMP_SGE;
+      break;
+    case EQ:
+      predicate = is_float ? llvm::CmpInst::FCMP_OEQ : llvm::CmpInst::ICMP_EQ;
+      break;
+    default:
+      // true for NaN, like !=
+      predicate = is_float ? llvm::CmpInst::FCMP_UNE : llvm::CmpInst::ICMP_NE;
+      break;
+  }
+  if (is_float)
+    return new llvm::FCmpInst(*context.currentBlock(), predicate, lhs, rhs);
+  return new llvm::ICmpInst(*context.currentBlock(), predicate, lhs, rhs);
+}
+
+llvm::Value* VectorOp::generateCode(DeviantLLVM& context) {
+  if (op_ == BUILD)
+    return generateBuild(context);
+  if (op_ == SHUFFLE)
+    return generateShuffle(context);
+
+  if (args_.size() != 1) {
+    context.error() << "reduce takes one vector\n";
+    return nullptr;
+  }
+  llvm::Value* vector = args_[0]->generateCode(context);
+  if (!vector)
+    return nullptr;
+  if (!vector->getType()->isVectorTy()) {
+    context.error() << "reduce of " << typeName(vector->getType())
+                    << ", which is not a vector\n";
+    return nullptr;
+  }
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  llvm::Type* element = vector->getType()->getScalarType();
+  if (!element->isFloatTy())
+    return builder->CreateAddReduce(vector);
+  // the lanes may be added in any order, so the reduction is a tree of
+  // vector adds instead of a chain of scalar ones
+  llvm::Value* sum = builder->CreateFAddReduce(
+      llvm::ConstantFP::getNegativeZero(element), vector);
+  llvm::cast<llvm::Instruction>(sum)->setHasAllowReassoc(true);
+  return sum;
+}
+
+llvm::Value* VectorOp::generateBuild(DeviantLLVM& context) {
+  auto type = llvm::cast<llvm::FixedVectorType>(context.getType(result_));
+  const unsigned lanes = type->getNumElements();
+  if (args_.size() != 1 && args_.size() != lanes) {
+    context.error() << typeName(type) << " takes 1 or " << lanes << " values\n";
+    return nullptr;
+  }
+
+  if (args_.size() == 1) {  // splat
+    llvm::Value* value = args_[0]->generateCode(context);
+    if (!value)
+      return nullptr;
+    return convert(context, value, type);
+  }
+
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  llvm::Value* vector = llvm::PoisonValue::get(type);
+  for (unsigned lane = 0; lane < lanes; ++lane) {
+    llvm::Value* value = args_[lane]->generateCode(context);
+    if (!value)
+      return nullptr;
+    value = convert(context, value, type->getElementType());
+    if (!value)
+      return nullptr;
+    vector = builder->CreateInsertElement(vector, value, lane);
+  }
+  return vector;
+}
+
+llvm::Value* VectorOp::generateShuffle(DeviantLLVM& context) {
+  if (args_.size() < 2) {
+    context.error() << "shuffle takes a vector and lane indices\n";
+    return nullptr;
+  }
+  llvm::Value* first = args_[0]->generateCode(context);
+  if (!first)
+    return nullptr;
+  auto type = llvm::dyn_cast<llvm::FixedVectorType>(first->getType());
+  if (!type) {
+    context.error() << "shuffle of " << typeName(first->getType())
+                    << ", which is not a vector\n";
+    return nullptr;
+  }
+
+  // a second vector unless the indices start right away
+  size_t indices = 1;
+  llvm::Value* second = llvm::PoisonValue::get(type);
+  if (args_[1]->type() != Type::INTEGER) {
+    second = args_[1]->generateCode(context);
+    if (!second)
+      return nullptr;
+    if (second->getType() != type) {
+      context.error() << "shuffle of " << typeName(type) << " and "
+                      << typeName(second->getType()) << "\n";
+      return nullptr;
+    }
+    indices = 2;
+  }
+
+  const int64_t lanes = type->getNumElements() * indices;
+  llvm::SmallVector<int, 8> mask;
+  for (size_t i = indices; i < args_.size(); ++i) {
+    if (args_[i]->type() != Type::INTEGER) {
+      context.error() << "shuffle indices must be constants\n";
+      return nullptr;
+    }
+    const int lane = static_cast<Integer*>(args_[i])->getValue();
+    if (lane < 0 || lane >= lanes) {
+      context.error() << "shuffle index " << lane << " out of range, there are "
+                      << lanes << " lanes\n";
+      return nullptr;
+    }
+    mask.push_back(lane);
+  }
+  if (mask.empty()) {
+    context.error() << "shuffle takes a vector and lane indices\n";
+    return nullptr;
+  }
+  return context.getBuilder()->CreateShuffleVector(first, second, mask);
+}
+
+llvm::Value* Subscript::generateCode(DeviantLLVM& context) {
+  // arrays are indexed in memory, not loaded as a whole
+  if (base_->type() == Type::IDENTIFIER) {
+    Variable* var =
+        context.findVariable(static_cast<Identifier*>(base_)->getName());
+    if (var && var->type->isArrayTy()) {
+      llvm::Value* ptr = elementPointer(context, var, index_);
+      if (!ptr)
+        return nullptr;
+      return context.getBuilder()->CreateLoad(
+          var->type->getArrayElementType(), ptr);
+    }
+  }
+
+  llvm::Value* base = base_->generateCode(context);
+  llvm::Value* index = index_->generateCode(context);
+  if (!base || !index)
+    return nullptr;
+  auto type = llvm::dyn_cast<llvm::FixedVectorType>(base->getType());
+  if (!type) {
+    context.error() << typeName(base->getType()) << " cannot be indexed\n";
+    return nullptr;
+  }
+  index = laneIndex(context, type, index);
+  if (!index)
+    return nullptr;
+  return context.getBuilder()->CreateExtractElement(base, index);
+}
+
+llvm::Type* ArrayDeclaration::elementType(DeviantLLVM& context) {
+  if (!values_.empty() && values_[0]->type() == Type::DECIMAL)
+    return context.getType(ValueType::FLOAT);
+  return context.getGenericIntegerType();
+}
+
+void ArrayDeclaration::declare(DeviantLLVM& context) {
+  context.declareGlobal(name_,
+                        llvm::ArrayType::get(elementType(context), length_));
+}
+
+llvm::Value* ArrayDeclaration::generateCode(DeviantLLVM& context) {
+  if (values_.size() > length_) {
+    context.error() << values_.size() << " values for an array of " << length_
+                    << "\n";
+    return nullptr;
+  }
+
+  if (global_) {
+    Variable* var = context.findGlobal(name_);
+    auto global = var ? llvm::cast<llvm::GlobalVariable>(var->slot) : nullptr;
+    if (!global || global->hasInitializer()) {
+      context.error() << "array " << context.getSymbolName(name_)
+                      << " defined twice\n";
+      return nullptr;
+    }
+    auto type = llvm::cast<llvm::ArrayType>(var->type);
+    llvm::SmallVector<llvm::Constant*, 16> elements;
+    for (Expression* value : values_) {
+      if (value->type() != Type::INTEGER && value->type() != Type::DECIMAL) {
+        context.error() << "values of the global array " << var->name
+                        << " must be literals\n";
+        return nullptr;
+      }
+      auto element = llvm::dyn_cast_or_null<llvm::Constant>(
+          convert(context, value->generateCode(context),
+                  type->getElementType()));
+      if (!element)
+        return nullptr;
+      elements.push_back(element);
+    }
+    elements.resize(length_,
+                    llvm::Constant::getNullValue(type->getElementType()));
+    global->setInitializer(llvm::ConstantArray::get(type, elements));
+    return global;
+  }
+
+  // the values first: their type is the element type
+  llvm::SmallVector<llvm::Value*, 16> values;
+  for (Expression* value : values_) {
+    values.push_back(value->generateCode(context));
+    if (!values.back())
+      return nullptr;
+  }
+  llvm::Type* element =
+      values.empty() ? context.getGenericIntegerType() : values[0]->getType();
+  auto type = llvm::ArrayType::get(element, length_);
+  Variable* var = context.declareArray(name_, type);
+  if (!var) {
+    context.error() << context.getSymbolName(name_) << " is already declared\n";
+    return nullptr;
+  }
+
+  llvm::IRBuilder<>* builder = context.getBuilder();
+  const llvm::DataLayout& layout = context.getModule()->getDataLayout();
+  builder->CreateMemSet(var->slot, builder->getInt8(0),
+                        layout.getTypeAllocSize(type),
+                        llvm::cast<llvm::AllocaInst>(var->slot)->getAlign());
+  for (size_t i = 0; i < values.size(); ++i) {
+    llvm::Value* value = convert(context, values[i], element);
+    if (!value)
+      return nullptr;
+    builder->CreateStore(value, builder->CreateConstInBoundsGEP2_32(
+                                    type, var->slot, 0, i));
+  }
+  return var->slot;
+}
+
+Expression* makeArithmetic(Arena& arena, Expression* lhs,
+                           ArithmeticOp::ArithOp op, Expression* rhs) {
+  Integer* left = asInteger(lhs);
+  Integer* right = asInteger(rhs);
+  if (left && right) {
+    if (auto value = evaluate(left->getValue(), op, right->getValue()))
+      return arena.make<Integer>(*value);
+    return arena.make<ArithmeticOp>(lhs, op, rhs);
+  }
+
+  // constants to the right: c + x -> x + c; literals have no side effects,
+  // so the order of evaluation does not matter. Anything else depends on
+  // the operand types, see ArithmeticOp::generateCode
+  if (left && (op == ArithmeticOp::ADD || op == ArithmeticOp::MUL))
+    return makeArithmetic(arena, rhs, op, lhs);
+  if (right && right->getValue() == 1 &&
+      (op == ArithmeticOp::MUL || op == ArithmeticOp::DIV))
+    return lhs;
+  return arena.make<ArithmeticOp>(lhs, op, rhs);
+}
+
+Expression* makeComparison(Arena& arena, Expression* lhs,
+                           ComparationOp::CompOp op, Expression* rhs) {
+  Integer* left = asInteger(lhs);
+  Integer* right = asInteger(rhs);
+  if (left && right) {
+    return arena.make<Integer>(
+        evaluate(left->getValue(), op, right->getValue()) ? 1 : 0);
+  }
+  return arena.make<ComparationOp>(lhs, op, rhs);
+}
+
+namespace {
+
+// branch weight of the expected side against 1 for the other, the same
+// ratio clang uses for __builtin_expect
+constexpr uint32_t kLikelyBranchWeight = 2000;
+
+// generate block in a scope of its own, starting in entry; returns the
+// block the code ends in, which is terminated if it does not fall through
+llvm::BasicBlock* generateArm(DeviantLLVM& context, Block* block,
+                              llvm::BasicBlock* entry) {
+  context.newScope(entry);
+  block->generateCode(context);
+  llvm::BasicBlock* end = context.currentBlock();
+  context.endScope();
+  return end;
+}
+
+}  // namespace
+
 llvm::Value* IfStatement::generateCode(DeviantLLVM& context) {
-#if 0
-  llvm::Value* cmp_result = condition_->generateCode(context);
-#endif
-  // hardcode
-  llvm::Value* cmp_result = llvm::ConstantInt::get(
-      llvm::Type::getInt1Ty(context.getGlobalContext()), true);
+  if (!condition_ || !then_)
+    return nullptr;
+
+  // a condition known at compile time, possibly folded by the parser: the
+  // live arm is generated in line and the dead one not at all
+  if (condition_->type() == Type::INTEGER) {
+    Block* live = static_cast<Integer*>(condition_)->getValue() ? then_ : else_;
+    if (live) {
+      llvm::BasicBlock* current = context.currentBlock();
+      context.setInsertPoint(generateArm(context, live, current));
+    }
+    return context.currentBlock();
+  }
 
+  llvm::Value* cmp_result = condition_->generateCondition(context);
   if (!cmp_result)
     return nullptr;
 
+  llvm::LLVMContext& llvm_context = context.getGlobalContext();
   llvm::Function* fn = context.currentBlock()->getParent();
   llvm::BasicBlock* then_block =
-      llvm::BasicBlock::Create(context.getGlobalContext(), "then", fn);
+      llvm::BasicBlock::Create(llvm_context, "then", fn);
   llvm::BasicBlock* else_block =
-      llvm::BasicBlock::Create(context.getGlobalContext(), "else");
+      else_ ? llvm::BasicBlock::Create(llvm_context, "else") : nullptr;
   llvm::BasicBlock* merge_block =
-      llvm::BasicBlock::Create(context.getGlobalContext(), "merge");
-  llvm::BranchInst::Create(then_block, else_block, cmp_result,
-                           context.currentBlock());
+      llvm::BasicBlock::Create(llvm_context, "merge");
+  llvm::BranchInst* branch = llvm::BranchInst::Create(
+      then_block, else_block ? else_block : merge_block, cmp_result,
+      context.currentBlock());
+  if (hint_ != Hint::NONE) {
+    llvm::MDBuilder md(llvm_context);
+    branch->setMetadata(
+        llvm::LLVMContext::MD_prof,
+        hint_ == Hint::LIKELY ? md.createBranchWeights(kLikelyBranchWeight, 1)
+                              : md.createBranchWeights(1, kLikelyBranchWeight));
+  }
+
+  // without an else, the false edge goes straight to merge
+  bool need_merge_block = !else_block;
+  context.sealBlock(then_block);
+  llvm::BasicBlock* end = generateArm(context, then_, then_block);
+  if (!end->getTerminator()) {
+    llvm::BranchInst::Create(merge_block, end);
+    need_merge_block = true;
+  }
+  if (else_block) {
+    fn->insert(fn->end(), else_block);
+    context.sealBlock(else_block);
+    end = generateArm(context, else_, else_block);
+    if (!end->getTerminator()) {
+      llvm::BranchInst::Create(merge_block, end);
+      need_merge_block = true;
+    }
+  }
+
+  if (need_merge_block) {
+    // code after the if continues in merge, whose phis join the values
+    // assigned in both arms
+    fn->insert(fn->end(), merge_block);
+    context.setInsertPoint(merge_block);
+  } else {
+    // both arms return; whatever follows is unreachable
+    delete merge_block;
+    context.setInsertPoint(
+        llvm::BasicBlock::Create(llvm_context, "unreachable", fn));
+  }
+  context.sealBlock(context.currentBlock());
+  return branch;
+}
 
-  bool need_merge_block = false;
+namespace {
 
-  context.newScope(then_block);
-  llvm::Value* then_val = then_->generateCode(context);
-  if (then_val == nullptr)
+// llvm.loop metadata for the hints, null without any
+llvm::MDNode* makeLoopID(llvm::LLVMContext& llvm_context, uint32_t unroll_count,
+                         LoopStatement::Vectorize vectorize) {
+  llvm::SmallVector<llvm::Metadata*, 4> ops;
+  ops.push_back(nullptr);  // the loop id refers to itself
+  llvm::Type* i32 = llvm::Type::getInt32Ty(llvm_context);
+  if (unroll_count == 1) {
+    ops.push_back(llvm::MDNode::get(
+        llvm_context, llvm::MDString::get(llvm_context,
+                                          "llvm.loop.unroll.disable")));
+  } else if (unroll_count > 1) {
+    ops.push_back(llvm::MDNode::get(
+        llvm_context,
+        {llvm::MDString::get(llvm_context, "llvm.loop.unroll.count"),
+         llvm::ConstantAsMetadata::get(
+             llvm::ConstantInt::get(i32, unroll_count))}));
+  }
+  if (vectorize != LoopStatement::Vectorize::DEFAULT) {
+    ops.push_back(llvm::MDNode::get(
+        llvm_context,
+        {llvm::MDString::get(llvm_context, "llvm.loop.vectorize.enable"),
+         llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(
+             llvm::Type::getInt1Ty(llvm_context),
+             vectorize == LoopStatement::Vectorize::ENABLE))}));
+  }
+  if (ops.size() == 1)
     return nullptr;
 
-  if (!context.currentBlock()->getTerminator()) {
-    llvm::BranchInst::Create(merge_block, context.currentBlock());
-    need_merge_block = true;
+  llvm::MDNode* loop_id = llvm::MDNode::getDistinct(llvm_context, ops);
+  loop_id->replaceOperandWith(0, loop_id);
+  return loop_id;
+}
+
+}  // namespace
+
+llvm::Value* LoopStatement::generateCode(DeviantLLVM& context) {
+  if (!body_)
+    return nullptr;
+
+  // variables of init are visible in the whole loop and nowhere else; the
+  // block they are initialized in is the preheader
+  context.newScope(context.currentBlock());
+  init_->generateCode(context);
+
+  llvm::LLVMContext& llvm_context = context.getGlobalContext();
+  llvm::Function* fn = context.currentBlock()->getParent();
+  llvm::BasicBlock* header =
+      llvm::BasicBlock::Create(llvm_context, "loop.header", fn);
+  llvm::BasicBlock* body = llvm::BasicBlock::Create(llvm_context, "loop.body");
+  llvm::BasicBlock* latch =
+      llvm::BasicBlock::Create(llvm_context, "loop.latch");
+  llvm::BasicBlock* exit = llvm::BasicBlock::Create(llvm_context, "loop.exit");
+  llvm::BranchInst::Create(header, context.currentBlock());
+
+  // the header stays unsealed until the back edge exists, so reads in the
+  // loop get phis for the values the latch brings around
+  context.setInsertPoint(header);
+  bool enters = true;
+  bool exits = true;
+  if (!condition_) {
+    exits = false;
+  } else if (condition_->type() == Type::INTEGER) {
+    enters = static_cast<Integer*>(condition_)->getValue() != 0;
+    exits = !enters;
+  }
+  if (enters && exits) {
+    llvm::Value* cmp_result = condition_->generateCondition(context);
+    if (!cmp_result) {
+      // the error fails the compile; the header still gets a terminator
+      // and its phis their operands, so the function stays well formed
+      if (!context.errors()) {
+        context.error() << "invalid loop condition\n";
+      }
+      llvm::BranchInst::Create(exit, context.currentBlock());
+      delete body;
+      delete latch;
+      context.sealBlock(header);
+      fn->insert(fn->end(), exit);
+      context.sealBlock(exit);
+      context.endScope();
+      context.setInsertPoint(exit);
+      return nullptr;
+    }
+    llvm::BranchInst::Create(body, exit, cmp_result, context.currentBlock());
+  } else {
+    llvm::BranchInst::Create(enters ? body : exit, context.currentBlock());
   }
 
-  fn->insert(fn->end(), else_block);
+  llvm::BranchInst* back_edge = nullptr;
+  if (enters) {
+    fn->insert(fn->end(), body);
+    context.sealBlock(body);
+    llvm::BasicBlock* end = generateArm(context, body_, body);
+    if (!end->getTerminator()) {
+      // the body falls through to the latch, which runs the step
+      llvm::BranchInst::Create(latch, end);
+      fn->insert(fn->end(), latch);
+      context.sealBlock(latch);
+      context.setInsertPoint(latch);
+      if (step_) {
+        step_->generateCode(context);
+      }
+      back_edge = llvm::BranchInst::Create(header, context.currentBlock());
+      if (llvm::MDNode* loop_id =
+              makeLoopID(llvm_context, unroll_count_, vectorize_)) {
+        back_edge->setMetadata(llvm::LLVMContext::MD_loop, loop_id);
+      }
+    } else {
+      delete latch;
+    }
+  } else {
+    delete body;
+    delete latch;
+  }
+  context.sealBlock(header);
+
+  // an endless loop leaves exit without predecessors; whatever follows is
+  // unreachable
+  fn->insert(fn->end(), exit);
+  context.sealBlock(exit);
   context.endScope();
+  context.setInsertPoint(exit);
+  return back_edge;
+}
 
-  context.newScope(else_block);
-  llvm::Value* else_val = nullptr;
-  if (else_) {
-    else_->generateCode(context);
+void AstNode::hash(AstHasher& hasher) { hasher.add(toString()); }
+
+void Integer::hash(AstHasher& hasher) {
+  hasher.add("int");
+  hasher.add(static_cast<int64_t>(value_));
+}
+
+void Decimal::hash(AstHasher& hasher) {
+  hasher.add("dec");
+  hasher.add(static_cast<int64_t>(std::bit_cast<uint32_t>(value_)));
+}
+
+void Identifier::hash(AstHasher& hasher) {
+  hasher.add("id");
+  hasher.addName(name_);
+}
+
+void VariableDeclaration::hash(AstHasher& hasher) {
+  hasher.add("var");
+  hasher.add(identifier_);
+  hasher.add(expr_);
+}
+
+void Assignment::hash(AstHasher& hasher) {
+  hasher.add("=");
+  hasher.addName(var_name_);
+  hasher.add(index_);
+  hasher.add(expr_);
+}
+
+void ArrayDeclaration::hash(AstHasher& hasher) {
+  hasher.add("array");
+  hasher.addName(name_);
+  hasher.add(static_cast<int64_t>(length_));
+  hasher.add(static_cast<int64_t>(global_));
+  hasher.add(static_cast<int64_t>(values_.size()));
+  for (auto value : values_) {
+    hasher.add(value);
   }
+}
 
-  if (!context.currentBlock()->getTerminator()) {
-    llvm::BranchInst::Create(merge_block, context.currentBlock());
-    need_merge_block = true;
+void Block::hash(AstHasher& hasher) {
+  hasher.add("{");
+  hasher.add(static_cast<int64_t>(statements_.size()));
+  for (auto stmt : statements_) {
+    hasher.add(stmt);
   }
-  context.endScope();
-  if (need_merge_block) {
-    context.newScope(merge_block);
-    fn->insert(fn->end(), merge_block);
-    context.getBuilder()->SetInsertPoint(merge_block);
+}
+
+void ReturnStatement::hash(AstHasher& hasher) {
+  hasher.add("ret");
+  hasher.add(static_cast<int64_t>(tail_));
+  hasher.add(ret_expr_);
+}
+
+void FunctionStatement::hash(AstHasher& hasher) {
+  hasher.add("fn");
+  hasher.addName(fn_name_);
+  hasher.add(static_cast<int64_t>(params_.size()));
+  for (const Parameter& param : params_) {
+    hasher.addName(param.name);
+    hasher.add(static_cast<int64_t>(param.type));
+  }
+  hasher.add(static_cast<int64_t>(return_type_));
+  hasher.add(static_cast<int64_t>(inlining_));
+  hasher.add(static_cast<int64_t>(exported_));
+  hasher.add(body_);
+}
+
+void FunctionCall::hash(AstHasher& hasher) {
+  hasher.add("call");
+  hasher.addCall(fn_name_);
+  hasher.add(static_cast<int64_t>(args_.size()));
+  for (auto arg : args_) {
+    hasher.add(arg);
   }
+}
+
+void ArithmeticOp::hash(AstHasher& hasher) {
+  hasher.add("arith");
+  hasher.add(static_cast<int64_t>(op_));
+  hasher.add(lhs_);
+  hasher.add(rhs_);
+}
+
+void Negation::hash(AstHasher& hasher) {
+  hasher.add("neg");
+  hasher.add(operand_);
+}
+
+void ComparationOp::hash(AstHasher& hasher) {
+  hasher.add("cmp");
+  hasher.add(static_cast<int64_t>(op_));
+  hasher.add(lhs_);
+  hasher.add(rhs_);
+}
+
+void VectorOp::hash(AstHasher& hasher) {
+  hasher.add("vector");
+  hasher.add(static_cast<int64_t>(op_));
+  hasher.add(static_cast<int64_t>(result_));
+  hasher.add(static_cast<int64_t>(args_.size()));
+  for (auto arg : args_) {
+    hasher.add(arg);
+  }
+}
+
+void Subscript::hash(AstHasher& hasher) {
+  hasher.add("[]");
+  hasher.add(base_);
+  hasher.add(index_);
+}
+
+void IfStatement::hash(AstHasher& hasher) {
+  hasher.add("if");
+  hasher.add(static_cast<int64_t>(hint_));
+  hasher.add(condition_);
+  hasher.add(then_);
+  hasher.add(else_);
+}
 
-  return merge_block;
+void LoopStatement::hash(AstHasher& hasher) {
+  hasher.add("loop");
+  hasher.add(static_cast<int64_t>(unroll_count_));
+  hasher.add(static_cast<int64_t>(vectorize_));
+  hasher.add(init_);
+  hasher.add(condition_);
+  hasher.add(step_);
+  hasher.add(body_);
 }
 
 }  // namespace deviant
\ No newline at end of file
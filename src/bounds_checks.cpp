@@ -0,0 +1,63 @@
+#include "bounds_checks.h"
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Module.h"
+#include "llvm/TargetParser/Triple.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+void BoundsChecks::eliminate(llvm::Function& fn) {
+  if (pending_.empty())
+    return;
+
+  // the analyses a pass manager would provide, for this function only
+  llvm::DominatorTree dominators(fn);
+  llvm::LoopInfo loops(dominators);
+  llvm::TargetLibraryInfoImpl library_info_impl(
+      llvm::Triple(fn.getParent()->getTargetTriple()));
+  llvm::TargetLibraryInfo library_info(library_info_impl, &fn);
+  llvm::AssumptionCache assumptions(fn);
+  llvm::ScalarEvolution evolution(fn, library_info, assumptions, dominators,
+                                  loops);
+
+  // decide about every check before the IR changes under the analyses
+  llvm::SmallVector<llvm::BranchInst*, 8> redundant;
+  for (llvm::BranchInst* check : pending_) {
+    auto cmp = llvm::cast<llvm::ICmpInst>(check->getCondition());
+    if (evolution.isKnownPredicateAt(
+            llvm::ICmpInst::ICMP_ULT, evolution.getSCEV(cmp->getOperand(0)),
+            evolution.getSCEV(cmp->getOperand(1)), cmp)) {
+      redundant.push_back(check);
+    } else {
+      ++kept_;
+    }
+  }
+  pending_.clear();
+
+  for (llvm::BranchInst* check : redundant) {
+    auto cmp = llvm::cast<llvm::ICmpInst>(check->getCondition());
+    llvm::BasicBlock* fail = check->getSuccessor(1);
+    llvm::BranchInst::Create(check->getSuccessor(0), check);
+    check->eraseFromParent();
+    if (cmp->use_empty()) {
+      cmp->eraseFromParent();
+    }
+    fail->eraseFromParent();
+    ++removed_;
+  }
+}
+
+}  // namespace deviant
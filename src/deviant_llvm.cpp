@@ -1,7 +1,147 @@
 #include "deviant_llvm.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "ast_hasher.h"
+#include "mem_stats.h"
+#include "timer.h"
+
 namespace deviant {
-DeviantLLVM::DeviantLLVM() {
+namespace {
+
+// run on the linked shards at -O2 and up: each shard was optimized on its
+// own, so calls between them are inlined only here, and functions that
+// became internal on the merge and are no longer called are dropped
+constexpr char kPostLinkPasses[] =
+    "globalopt,cgscc(inline,function(instcombine,simplifycfg)),globaldce";
+
+llvm::OptimizationLevel toLLVMLevel(OptLevel level) {
+  switch (level) {
+    case OptLevel::O1:
+      return llvm::OptimizationLevel::O1;
+    case OptLevel::O2:
+      return llvm::OptimizationLevel::O2;
+    case OptLevel::O3:
+      return llvm::OptimizationLevel::O3;
+    case OptLevel::Os:
+      return llvm::OptimizationLevel::Os;
+    default:
+      return llvm::OptimizationLevel::O0;
+  }
+}
+
+llvm::CodeGenOpt::Level toCodeGenLevel(OptLevel level) {
+  switch (level) {
+    case OptLevel::O0:
+      return llvm::CodeGenOpt::None;
+    case OptLevel::O1:
+      return llvm::CodeGenOpt::Less;
+    case OptLevel::O3:
+      return llvm::CodeGenOpt::Aggressive;
+    default:
+      return llvm::CodeGenOpt::Default;
+  }
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// target registration is not thread safe, and parallel workers each
+// create a TargetMachine
+void initializeNativeTarget() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+}
+
+// pass managers and adaptors only wrap the passes worth reporting
+bool isPassWrapper(llvm::StringRef pass) {
+  return pass.contains("PassManager") || pass.contains("PassAdaptor") ||
+         pass.contains("AnalysisManagerProxy") ||
+         pass == "ModuleInlinerWrapperPass" || pass == "DevirtSCCRepeatedPass";
+}
+
+// record every LLVM pass run as a "pass" interval; starts is the stack of
+// passes currently running, nested passes run inside adaptors
+void addPassTimers(llvm::PassInstrumentationCallbacks& instrumentation,
+                   std::vector<Profiler::Clock::time_point>& starts) {
+  instrumentation.registerBeforeNonSkippedPassCallback(
+      [&starts](llvm::StringRef pass, llvm::Any) {
+        if (!isPassWrapper(pass)) {
+          starts.push_back(Profiler::Clock::now());
+        }
+      });
+  auto after = [&starts](llvm::StringRef pass) {
+    if (isPassWrapper(pass) || starts.empty())
+      return;
+    Profiler::get().record("pass", std::string_view(pass.data(), pass.size()),
+                           starts.back(), Profiler::Clock::now());
+    starts.pop_back();
+  };
+  instrumentation.registerAfterPassCallback(
+      [after](llvm::StringRef pass, llvm::Any,
+              const llvm::PreservedAnalyses&) { after(pass); });
+  instrumentation.registerAfterPassInvalidatedCallback(
+      [after](llvm::StringRef pass, const llvm::PreservedAnalyses&) {
+        after(pass);
+      });
+}
+
+// static library built from runtime/, see CMakeLists.txt
+#ifndef DEVIANT_RUNTIME_LIB
+#define DEVIANT_RUNTIME_LIB ""
+#endif
+
+}  // namespace
+
+DeviantLLVM::DeviantLLVM(const CompileOptions& options) : options_(options) {
+  print_symbol_ = interner_.intern("print");
+  initModule();
+  setupExternFunctions();
+}
+
+DeviantLLVM::DeviantLLVM(const CompileOptions& options,
+                         const Interner& interner)
+    : options_(options), interner_(interner) {
+  print_symbol_ = interner_.intern("print");
   initModule();
   setupExternFunctions();
 }
@@ -13,9 +153,767 @@ void DeviantLLVM::initModule() {
   builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
 }
 
-void DeviantLLVM::saveModuleToFile(const std::string& filename) {
-  std::error_code err_code;
-  llvm::raw_fd_ostream out(filename, err_code);
-  module_->print(out, nullptr);
+void DeviantLLVM::endScope() {
+  variables_.exitScope();
+  scope_blocks_.pop_back();
+  if (!scope_blocks_.empty()) {
+    builder_->SetInsertPoint(scope_blocks_.back());
+  } else {
+    function_variables_.clear();
+    ssa_.clear();
+  }
+}
+
+Variable* DeviantLLVM::declareVariable(Symbol var_name, llvm::Type* type) {
+  if (variables_.find(var_name))  // already declared
+    return nullptr;
+
+  Variable& var = function_variables_.emplace_back(
+      Variable{var_name, getSymbolName(var_name), type, nullptr});
+  if (options_.ssa) {
+    // a fresh declaration reads as undefined until assigned
+    ssa_.write(&var, currentBlock(), llvm::UndefValue::get(type));
+  } else {
+    var.slot = createEntryAlloca(type, var.name);
+  }
+  variables_.bind(var_name, &var);
+  return &var;
+}
+
+Variable* DeviantLLVM::declareArray(Symbol var_name, llvm::ArrayType* type) {
+  if (variables_.find(var_name))  // already declared
+    return nullptr;
+
+  Variable& var = function_variables_.emplace_back(Variable{
+      var_name, getSymbolName(var_name), type, nullptr});
+  var.slot = createEntryAlloca(type, var.name);
+  variables_.bind(var_name, &var);
+  return &var;
+}
+
+llvm::AllocaInst* DeviantLLVM::createEntryAlloca(llvm::Type* type,
+                                                 llvm::StringRef name) {
+  // once per call however often the declaration runs, e.g. in a loop
+  llvm::BasicBlock& entry = currentBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> builder(&entry, entry.getFirstInsertionPt());
+  return builder.CreateAlloca(type, nullptr, name);
+}
+
+Variable* DeviantLLVM::findGlobal(Symbol var_name) {
+  if (var_name < globals_.size() && globals_[var_name])
+    return globals_[var_name];
+  if (var_name < global_declarations_.size() &&
+      global_declarations_[var_name]) {
+    ArrayDeclaration* array = global_declarations_[var_name];
+    global_declarations_[var_name] = nullptr;
+    array->declare(*this);
+    return findGlobal(var_name);
+  }
+  return nullptr;
+}
+
+Variable* DeviantLLVM::declareGlobal(Symbol var_name, llvm::ArrayType* type) {
+  if (Variable* var = findGlobal(var_name))
+    return var;
+
+  const std::string_view name = getSymbolName(var_name);
+  auto global = new llvm::GlobalVariable(
+      *module_, type, false, llvm::GlobalValue::ExternalLinkage, nullptr,
+      llvm::StringRef(name.data(), name.size()));
+  Variable& var = global_variables_.emplace_back(
+      Variable{var_name, name, type, global});
+  if (var_name >= globals_.size()) {
+    globals_.resize(interner_.size(), nullptr);
+  }
+  globals_[var_name] = &var;
+  return &var;
+}
+
+void DeviantLLVM::registerGlobal(ArrayDeclaration* array) {
+  if (array->getName() >= global_declarations_.size()) {
+    global_declarations_.resize(interner_.size(), nullptr);
+  }
+  global_declarations_[array->getName()] = array;
+}
+
+bool DeviantLLVM::checkBounds(llvm::Value* index, uint64_t length) {
+  if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(index)) {
+    if (constant->getValue().ult(length)) {
+      bounds_checks_.skip();
+      return true;
+    }
+    error() << "index " << constant->getSExtValue()
+            << " out of bounds of an array of " << length << "\n";
+    return false;
+  }
+  if (!options_.bounds_checks) {
+    bounds_checks_.skip();
+    return true;
+  }
+
+  llvm::BasicBlock* current = currentBlock();
+  llvm::Function* fn = current->getParent();
+  llvm::BasicBlock* in_bounds =
+      llvm::BasicBlock::Create(getGlobalContext(), "bounds.ok", fn);
+  llvm::BasicBlock* fail =
+      llvm::BasicBlock::Create(getGlobalContext(), "bounds.fail", fn);
+  llvm::Value* length_value = llvm::ConstantInt::get(index->getType(), length);
+  auto cmp = new llvm::ICmpInst(*current, llvm::CmpInst::ICMP_ULT, index,
+                                length_value);
+  llvm::BranchInst* check =
+      llvm::BranchInst::Create(in_bounds, fail, cmp, current);
+  check->setMetadata(
+      llvm::LLVMContext::MD_prof,
+      llvm::MDBuilder(getGlobalContext()).createBranchWeights(2000, 1));
+  llvm::CallInst::Create(getBoundsFailFunction(), {index, length_value}, "",
+                         fail);
+  new llvm::UnreachableInst(getGlobalContext(), fail);
+  bounds_checks_.add(check);
+
+  sealBlock(in_bounds);
+  sealBlock(fail);
+  setCurrentBlock(in_bounds);
+  return true;
+}
+
+void DeviantLLVM::eliminateBoundsChecks(llvm::Function& fn) {
+  ScopedTimer timer("phase", "bounds checks");
+  bounds_checks_.eliminate(fn);
+}
+
+llvm::Value* DeviantLLVM::readVariable(Variable* var) {
+  if (options_.ssa)
+    return ssa_.read(var, currentBlock());
+  return new llvm::LoadInst(var->type, var->slot, var->name, false,
+                            currentBlock());
+}
+
+void DeviantLLVM::writeVariable(Variable* var, llvm::Value* value) {
+  if (options_.ssa) {
+    ssa_.write(var, currentBlock(), value);
+  } else {
+    new llvm::StoreInst(value, var->slot, false, currentBlock());
+  }
+}
+
+Program* DeviantLLVM::parse(std::string_view program) {
+  ScopedTimer timer("phase", "parse");
+  parser_ = std::make_unique<Parser>(program, arena_, interner_);
+  ast_nodes_ = arena_.objects();
+  Program* ast = parser_->parse();
+  ast_nodes_ = arena_.objects() - ast_nodes_;
+  tokens_ = parser_->tokens();
+  return ast;
+}
+
+int DeviantLLVM::execute(std::string_view program) {
+  // a bad pipeline is an option error, reported before any work and once
+  // rather than by every shard
+  if (!checkPassPipeline())
+    return EXIT_FAILURE;
+
+  // parse the program
+  Program* ast = parse(program);
+  if (parser_->errors())
+    return EXIT_FAILURE;
+
+  if (sharded())
+    return executeSharded(*ast);
+
+  // compile to LLVM IR
+  {
+    ScopedTimer timer("phase", "codegen");
+    compile(*ast);
+  }
+  if (errors_)
+    return EXIT_FAILURE;
+  if (MemStats::enabled()) {
+    instructions_ = module_->getInstructionCount();
+  }
+
+#ifdef _DEBUG
+// print generated codex
+  module_->print(llvm::outs(), nullptr);
+#endif
+
+  // plain -O0 IR output needs no target, everything else does
+  const bool native =
+      options_.mode != Mode::COMPILE || options_.emit == Emit::OBJ;
+  if ((optimizing() || native) && !initTarget())
+    return EXIT_FAILURE;
+
+  // run the pass pipeline selected by the options
+  if (!optimize())
+    return EXIT_FAILURE;
+
+  return emit();
+}
+
+int DeviantLLVM::executeSharded(Program& ast) {
+  const unsigned jobs =
+      options_.jobs ? options_.jobs
+                    : llvm::hardware_concurrency().compute_thread_count();
+  const size_t count = ast.size();
+
+  // each shard only sees its own definitions, so a global array defined
+  // twice in different shards has to be caught before splitting
+  std::vector<char> defined(interner_.size(), false);
+  for (size_t i = 0; i < count; ++i) {
+    if (ast.statement(i)->type() != AstNode::Type::ARRAY)
+      continue;
+    const Symbol name =
+        static_cast<ArrayDeclaration*>(ast.statement(i))->getName();
+    if (defined[name]) {
+      error() << "array " << getSymbolName(name) << " defined twice\n";
+      return EXIT_FAILURE;
+    }
+    defined[name] = true;
+  }
+
+  // executables link the shards' objects, so the backend runs in parallel
+  // too; everything else is merged back into one module
+  const bool object = options_.mode == Mode::EXECUTABLE;
+
+  // contiguous slices keep the output order independent of scheduling; a
+  // cache needs one slice per function to look them up one by one
+  std::vector<std::pair<size_t, size_t>> slices;
+  if (!options_.cache_dir.empty()) {
+    for (size_t i = 0; i < count; ++i) {
+      slices.emplace_back(i, i + 1);
+    }
+  } else {
+    const size_t shards = std::max<size_t>(1, std::min<size_t>(jobs, count));
+    for (size_t i = 0; i < shards; ++i) {
+      slices.emplace_back(count * i / shards, count * (i + 1) / shards);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<CodeBuffer> code(slices.size());
+  std::vector<char> ok(slices.size(), false);  // not vector<bool>: workers
+  std::atomic<size_t> instructions{0};
+  std::atomic<size_t> bounds_removed{0};
+  std::atomic<size_t> bounds_kept{0};
+
+  std::unique_ptr<FunctionCache> cache;
+  std::vector<std::string> keys;
+  std::vector<char> cached(slices.size(), false);
+  if (!options_.cache_dir.empty()) {
+    cache = std::make_unique<FunctionCache>(options_.cache_dir,
+                                            options_.cache_size);
+    if (!cache->open())
+      return EXIT_FAILURE;
+
+    // the key covers the target, so it has to exist first, and callee
+    // signatures, which are known once everything is declared
+    if ((optimizing() || object) && !initTarget())
+      return EXIT_FAILURE;
+    ast.declare(*this);
+
+    std::string config;
+    llvm::raw_string_ostream os(config);
+    os << "deviant 1.0.0 llvm " << LLVM_VERSION_STRING << " -O"
+       << static_cast<int>(options_.opt_level) << " passes=" << options_.passes
+       << (options_.ssa ? " ssa" : " memory")
+       << (options_.bounds_checks ? " checked" : " unchecked")
+       << (object ? " obj " : " bc ");
+    if (target_machine_) {
+      os << target_machine_->getTargetTriple().str() << " "
+         << target_machine_->getTargetCPU() << " "
+         << target_machine_->getTargetFeatureString();
+    }
+    os.flush();
+
+    ScopedTimer timer("phase", "cache lookup");
+    for (size_t i = 0; i < slices.size(); ++i) {
+      keys.push_back(cacheKey(ast.statement(i), config));
+      cached[i] = ok[i] = cache->lookup(keys.back(), code[i]);
+    }
+  }
+
+  {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(jobs));
+    for (size_t i = 0; i < slices.size(); ++i) {
+      if (ok[i])  // cached
+        continue;
+      pool.async([&, i] {
+        ScopedTimer timer("phase", "shard");
+        DeviantLLVM worker(options_, interner_);
+        ok[i] = worker.compileShard(ast, slices[i].first, slices[i].second,
+                                    object, code[i]);
+        instructions += worker.instructions_;
+        bounds_removed += worker.bounds_checks_.removed();
+        bounds_kept += worker.bounds_checks_.kept();
+      });
+    }
+    pool.wait();
+  }
+  instructions_ = instructions;
+  bounds_removed_ = bounds_removed;
+  bounds_kept_ = bounds_kept;
+  if (std::find(ok.begin(), ok.end(), false) != ok.end())
+    return EXIT_FAILURE;
+
+  if (cache) {
+    ScopedTimer timer("phase", "cache store");
+    for (size_t i = 0; i < slices.size(); ++i) {
+      if (!cached[i]) {
+        cache->store(keys[i], code[i]);
+      }
+    }
+    cache->flush();
+  }
+
+  if (options_.verbose) {
+    llvm::errs() << llvm::format(
+        "codegen: %zu shards on %u threads, %.3f ms\n", slices.size(), jobs,
+        millisecondsSince(start));
+    if (cache) {
+      cache->printStats(llvm::errs());
+    }
+  }
+
+  if (object)
+    return linkExecutable(code, options_.output) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  {
+    ScopedTimer timer("phase", "link shards");
+    if (!linkShards(code))
+      return EXIT_FAILURE;
+  }
+
+  // the shards are optimized already, only what crosses them is left
+  if (options_.passes.empty() && options_.opt_level >= OptLevel::O2 &&
+      options_.opt_level != OptLevel::Os) {
+    if (!target_machine_ && !initTarget())
+      return EXIT_FAILURE;
+    if (!optimize(true))
+      return EXIT_FAILURE;
+  }
+  if (options_.mode == Mode::COMPILE && options_.emit == Emit::OBJ &&
+      !target_machine_ && !initTarget())
+    return EXIT_FAILURE;
+  return emit();
+}
+
+std::string DeviantLLVM::cacheKey(Statement* stmt, const std::string& config) {
+  AstHasher hasher(interner_);
+  hasher.add(config);
+  hasher.add(stmt);
+
+  // calls are compiled against the callee's declaration only
+  std::string signatures;
+  llvm::raw_string_ostream os(signatures);
+  for (Symbol callee : hasher.callees()) {
+    llvm::Function* fn =
+        callee == print_symbol_ ? print_fn_ : getFunction(callee);
+    if (fn) {
+      fn->getFunctionType()->print(os);
+      os << " cc" << fn->getCallingConv();
+    } else {
+      os << "undeclared";
+    }
+    os << ";";
+  }
+  // and against the global arrays, whose lengths the bounds checks use
+  for (const llvm::GlobalVariable& global : module_->globals()) {
+    os << global.getName() << ":";
+    global.getValueType()->print(os);
+    os << ";";
+  }
+  os.flush();
+  hasher.add(signatures);
+  return hasher.finish();
+}
+
+bool DeviantLLVM::compileShard(Program& ast, size_t first, size_t last,
+                               bool object, CodeBuffer& out) {
+  ast.generateCode(*this, first, last);
+  if (errors_)
+    return false;
+  if (MemStats::enabled()) {
+    instructions_ = module_->getInstructionCount();
+  }
+
+  if ((optimizing() || object) && !initTarget())
+    return false;
+  if (!optimize())
+    return false;
+
+  llvm::raw_svector_ostream os(out);
+  if (object)
+    return emitObject(os);
+
+  // the bitcode reader rejects what the verifier would
+  if (llvm::verifyModule(*module_)) {
+    llvm::errs() << "Deviant Error: invalid module, cannot merge shards\n";
+    return false;
+  }
+  llvm::WriteBitcodeToFile(*module_, os);
+  return true;
+}
+
+bool DeviantLLVM::linkShards(const std::vector<CodeBuffer>& shards) {
+  llvm::Linker linker(*module_);
+  for (const CodeBuffer& code : shards) {
+    auto shard = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(llvm::StringRef(code.data(), code.size()),
+                              "shard"),
+        *context_);
+    if (!shard) {
+      llvm::errs() << "Deviant Error: " << llvm::toString(shard.takeError())
+                   << "\n";
+      return false;
+    }
+    if (linker.linkInModule(std::move(*shard))) {
+      llvm::errs() << "Deviant Error: cannot link the code of all threads\n";
+      return false;
+    }
+  }
+  for (llvm::Function& fn : *module_) {
+    if (!fn.isDeclaration() && fn.hasHiddenVisibility()) {
+      fn.setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+  }
+  return true;
+}
+
+int DeviantLLVM::emit() {
+  switch (options_.mode) {
+    case Mode::RUN:
+      return runJIT();
+    case Mode::EXECUTABLE:
+      return emitExecutable(options_.output) ? EXIT_SUCCESS : EXIT_FAILURE;
+    default:
+      return writeModule(options_.emit, options_.output) ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE;
+  }
+}
+
+bool DeviantLLVM::finish() {
+  // tearing down the module overlaps with the write
+  ScopedTimer timer("phase", "finish");
+  builder_.reset();
+  module_.reset();
+  context_.reset();
+  return output_ ? output_->wait() : true;
+}
+
+bool DeviantLLVM::initTarget() {
+  initializeNativeTarget();
+
+  const std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string error;
+  const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    llvm::errs() << "Deviant Error: " << error << "\n";
+    return false;
+  }
+
+  // tune for the machine we run on, like -march=native
+  std::string features;
+  llvm::StringMap<bool> host_features;
+  if (llvm::sys::getHostCPUFeatures(host_features)) {
+    for (auto& feature : host_features) {
+      features += (features.empty() ? "" : ",");
+      features += (feature.second ? "+" : "-");
+      features += feature.first();
+    }
+  }
+
+  target_machine_.reset(target->createTargetMachine(
+      triple, llvm::sys::getHostCPUName(), features,
+      llvm::TargetOptions(), llvm::Reloc::PIC_, std::nullopt,
+      toCodeGenLevel(options_.opt_level)));
+  if (!target_machine_) {
+    llvm::errs() << "Deviant Error: no target machine for " << triple << "\n";
+    return false;
+  }
+
+  module_->setTargetTriple(triple);
+  module_->setDataLayout(target_machine_->createDataLayout());
+  return true;
+}
+
+bool DeviantLLVM::emitObject(llvm::raw_pwrite_stream& out) {
+  ScopedTimer timer("phase", "emit object");
+  llvm::legacy::PassManager codegen;
+  if (target_machine_->addPassesToEmitFile(codegen, out, nullptr,
+                                           llvm::CGFT_ObjectFile)) {
+    llvm::errs() << "Deviant Error: the target cannot emit object files\n";
+    return false;
+  }
+  codegen.run(*module_);
+  return true;
+}
+
+bool DeviantLLVM::emitExecutable(const std::string& filename) {
+  std::vector<CodeBuffer> objects(1);
+  llvm::raw_svector_ostream os(objects[0]);
+  return emitObject(os) && linkExecutable(objects, filename);
+}
+
+bool DeviantLLVM::linkExecutable(const std::vector<CodeBuffer>& objects,
+                                 const std::string& filename) {
+  // the linker needs the objects on disk: write them all, then wait
+  std::vector<llvm::SmallString<128>> paths(objects.size());
+  std::vector<std::unique_ptr<OutputFile>> files;
+  bool written = true;
+  for (size_t i = 0; i < objects.size() && written; ++i) {
+    if (auto err_code =
+            llvm::sys::fs::createTemporaryFile("deviant", "o", paths[i])) {
+      llvm::errs() << "Deviant Error: " << err_code.message() << "\n";
+      written = false;
+      break;
+    }
+    files.push_back(std::make_unique<OutputFile>());
+    written = files.back()->open(std::string(paths[i]));
+    if (written) {
+      files.back()->stream().write(objects[i].data(), objects[i].size());
+      files.back()->commit();
+    }
+  }
+  for (auto& file : files) {
+    written = file->wait() && written;
+  }
+
+  ScopedTimer timer("phase", "link");
+  bool linked = false;
+  if (written) {
+    // the C compiler driver knows the system's crt files and libc
+    const char* cc_env = std::getenv("CC");
+    const char* rt_env = std::getenv("DEVIANT_RUNTIME");
+    std::string runtime = rt_env ? rt_env : DEVIANT_RUNTIME_LIB;
+    auto cc = llvm::sys::findProgramByName(cc_env ? cc_env : "cc");
+    if (!cc) {
+      llvm::errs() << "Deviant Error: no C compiler found to link with\n";
+    } else {
+      llvm::SmallVector<llvm::StringRef, 8> args{*cc};
+      for (const auto& path : paths) {
+        args.push_back(path.str());
+      }
+      args.push_back("-o");
+      args.push_back(filename);
+      if (!runtime.empty()) {
+        args.push_back(runtime);
+      }
+      std::string error;
+      int status = llvm::sys::ExecuteAndWait(*cc, args, std::nullopt, {}, 0, 0,
+                                             &error);
+      linked = (status == 0);
+      if (!linked) {
+        llvm::errs() << "Deviant Error: linking failed"
+                     << (error.empty() ? "" : ": ") << error << "\n";
+      }
+    }
+  }
+
+  for (const auto& path : paths) {
+    if (!path.empty()) {
+      llvm::sys::fs::remove(path);
+    }
+  }
+  return linked;
+}
+
+bool DeviantLLVM::checkPassPipeline() const {
+  if (options_.passes.empty())
+    return true;
+  llvm::PassBuilder pb;
+  llvm::ModulePassManager mpm;
+  if (auto err = pb.parsePassPipeline(mpm, options_.passes)) {
+    llvm::errs() << "Deviant Error: invalid pass pipeline: "
+                 << llvm::toString(std::move(err)) << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool DeviantLLVM::optimize(bool post_link) {
+  if (options_.opt_level == OptLevel::O0 && options_.passes.empty())
+    return true;
+
+  // passes assume well-formed IR
+  {
+    ScopedTimer timer("phase", "verify");
+    if (llvm::verifyModule(*module_, &llvm::errs())) {
+      llvm::errs() << "Deviant Error: invalid module, cannot optimize it\n";
+      return false;
+    }
+  }
+
+  ScopedTimer timer("phase", "optimize");
+  llvm::PassInstrumentationCallbacks instrumentation;
+  std::vector<Profiler::Clock::time_point> pass_starts;
+  if (Profiler::timing()) {
+    addPassTimers(instrumentation, pass_starts);
+  }
+
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  llvm::PassBuilder pb(target_machine_.get(), llvm::PipelineTuningOptions(),
+                       std::nullopt, &instrumentation);
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  llvm::ModulePassManager mpm;
+  if (post_link) {
+    if (auto err = pb.parsePassPipeline(mpm, kPostLinkPasses)) {
+      llvm::errs() << "Deviant Error: invalid post-link pipeline: "
+                   << llvm::toString(std::move(err)) << "\n";
+      return false;
+    }
+  } else if (!options_.passes.empty()) {
+    if (auto err = pb.parsePassPipeline(mpm, options_.passes)) {
+      llvm::errs() << "Deviant Error: invalid pass pipeline: "
+                   << llvm::toString(std::move(err)) << "\n";
+      return false;
+    }
+  } else if (options_.opt_level == OptLevel::O0) {
+    mpm = pb.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+  } else {
+    mpm = pb.buildPerModuleDefaultPipeline(toLLVMLevel(options_.opt_level));
+  }
+
+  mpm.run(*module_, mam);
+  return true;
+}
+
+int DeviantLLVM::runJIT() {
+  initializeNativeTarget();
+
+  auto report = [](llvm::Error err) {
+    llvm::errs() << "Deviant Error: " << llvm::toString(std::move(err))
+                 << "\n";
+    return EXIT_FAILURE;
+  };
+
+  auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb)
+    return report(jtmb.takeError());
+  jtmb->setCodeGenOptLevel(toCodeGenLevel(options_.opt_level));
+
+  auto jit = llvm::orc::LLJITBuilder()
+                 .setJITTargetMachineBuilder(std::move(*jtmb))
+                 .create();
+  if (!jit)
+    return report(jit.takeError());
+
+  // resolve printf and other externs from the host process
+  auto host = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*jit)->getDataLayout().getGlobalPrefix());
+  if (!host)
+    return report(host.takeError());
+  (*jit)->getMainJITDylib().addGenerator(std::move(*host));
+
+  module_->setDataLayout((*jit)->getDataLayout());
+  builder_.reset();
+  if (auto err = (*jit)->addIRModule(
+          llvm::orc::ThreadSafeModule(std::move(module_), std::move(context_))))
+    return report(std::move(err));
+
+  // lookup materializes main and everything it references
+  auto compile_start = std::chrono::steady_clock::now();
+  auto main_addr = (*jit)->lookup("main");
+  if (!main_addr)
+    return report(main_addr.takeError());
+  double compile_ms = millisecondsSince(compile_start);
+
+  auto main_fn = main_addr->toPtr<int (*)()>();
+  auto run_start = std::chrono::steady_clock::now();
+  int status = main_fn();
+  double run_ms = millisecondsSince(run_start);
+
+  if (Profiler::timing()) {
+    Profiler::get().record("phase", "jit", compile_start, run_start);
+    Profiler::get().record("phase", "run", run_start, Profiler::Clock::now());
+  }
+
+  fflush(stdout);
+  if (options_.verbose) {
+    llvm::errs() << llvm::format("jit: %.3f ms compiling, %.3f ms running\n",
+                                 compile_ms, run_ms);
+  }
+  return status;
+}
+
+void DeviantLLVM::printArenaStats(llvm::raw_ostream& os) const {
+  os << "arena: " << ast_nodes_ << " AST nodes, " << arena_.objects()
+     << " objects, " << arena_.bytesUsed() << " bytes used, "
+     << arena_.bytesReserved() << " bytes reserved in " << arena_.blocks()
+     << " blocks\n";
+}
+
+void DeviantLLVM::printBoundsCheckStats(llvm::raw_ostream& os) const {
+  const size_t removed = bounds_removed_ + bounds_checks_.removed();
+  const size_t kept = bounds_kept_ + bounds_checks_.kept();
+  if (removed + kept == 0)
+    return;
+  os << "bounds checks: " << removed << " removed, " << kept << " kept\n";
+}
+
+void DeviantLLVM::printMemStats(llvm::raw_ostream& os) const {
+  auto phase = [](llvm::json::OStream& json, const MemStats::Phase& phase) {
+    json.object([&] {
+      json.attribute("name", phase.name);
+      json.attribute("depth", static_cast<int64_t>(phase.depth));
+      json.attribute("allocations", static_cast<int64_t>(phase.allocations));
+      json.attribute("bytes", static_cast<int64_t>(phase.bytes));
+      json.attribute("peak_live_bytes", phase.peak_live_bytes);
+      json.attribute("peak_rss_bytes", phase.peak_rss_bytes);
+    });
+  };
+
+  llvm::json::OStream json(os, 2);
+  json.object([&] {
+    json.attributeArray("phases", [&] {
+      for (const MemStats::Phase& p : MemStats::phases()) {
+        phase(json, p);
+      }
+    });
+    json.attributeBegin("total");
+    phase(json, MemStats::total());
+    json.attributeEnd();
+    json.attribute("tokens", static_cast<int64_t>(tokens_));
+    json.attribute("ast_nodes", static_cast<int64_t>(ast_nodes_));
+    json.attribute("llvm_instructions", static_cast<int64_t>(instructions_));
+    json.attributeObject("arena", [&] {
+      json.attribute("objects", static_cast<int64_t>(arena_.objects()));
+      json.attribute("bytes_used", static_cast<int64_t>(arena_.bytesUsed()));
+      json.attribute("bytes_reserved",
+                     static_cast<int64_t>(arena_.bytesReserved()));
+      json.attribute("blocks", static_cast<int64_t>(arena_.blocks()));
+    });
+  });
+  os << "\n";
+}
+
+bool DeviantLLVM::writeModule(Emit emit, const std::string& filename) {
+  ScopedTimer timer("phase", "emit");
+  output_ = std::make_unique<OutputFile>();
+  if (!output_->open(filename))
+    return false;
+
+  switch (emit) {
+    case Emit::BC:
+      llvm::WriteBitcodeToFile(*module_, output_->stream());
+      break;
+    case Emit::OBJ:
+      if (!emitObject(output_->stream()))
+        return false;
+      break;
+    default:
+      module_->print(output_->stream(), nullptr);
+      break;
+  }
+
+  output_->commit();
+  return true;
 }
 }  // namespace deviant
\ No newline at end of file
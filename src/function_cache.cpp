@@ -0,0 +1,134 @@
+#include "function_cache.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+bool FunctionCache::open() {
+  if (auto err_code = llvm::sys::fs::create_directories(dir_)) {
+    llvm::errs() << "Deviant Error: cannot create cache directory " << dir_
+                 << ": " << err_code.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+std::string FunctionCache::path(const std::string& key) const {
+  llvm::SmallString<128> path(dir_);
+  llvm::sys::path::append(path, key + ".dvc");
+  return std::string(path);
+}
+
+bool FunctionCache::lookup(const std::string& key, CodeBuffer& code) {
+  const std::string file = path(key);
+  int fd;
+  if (llvm::sys::fs::openFileForRead(file, fd)) {
+    ++misses_;
+    return false;
+  }
+
+  auto buffer = llvm::MemoryBuffer::getOpenFile(fd, file, -1);
+  if (buffer) {
+    // recently used entries survive eviction
+    llvm::sys::fs::setLastAccessAndModificationTime(
+        fd, std::chrono::system_clock::now());
+  }
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  if (!buffer) {
+    ++misses_;
+    return false;
+  }
+
+  code.assign((*buffer)->getBufferStart(), (*buffer)->getBufferEnd());
+  ++hits_;
+  return true;
+}
+
+void FunctionCache::store(const std::string& key, const CodeBuffer& code) {
+  Pending entry;
+  entry.path = path(key);
+
+  llvm::SmallString<128> temp;
+  llvm::sys::fs::createUniquePath(entry.path + "-%%%%%%.tmp", temp, false);
+  entry.temp = std::string(temp);
+
+  entry.file = std::make_unique<OutputFile>();
+  if (!entry.file->open(entry.temp))
+    return;
+  entry.file->stream().write(code.data(), code.size());
+  entry.file->commit();
+  pending_.push_back(std::move(entry));
+}
+
+void FunctionCache::flush() {
+  for (Pending& entry : pending_) {
+    if (entry.file->wait() && !llvm::sys::fs::rename(entry.temp, entry.path))
+      continue;
+    llvm::sys::fs::remove(entry.temp);
+  }
+  pending_.clear();
+  evict();
+}
+
+void FunctionCache::evict() {
+  struct Entry {
+    std::string path;
+    uint64_t size;
+    llvm::sys::TimePoint<> used;
+  };
+  std::vector<Entry> entries;
+  bytes_ = 0;
+
+  std::error_code err_code;
+  for (llvm::sys::fs::directory_iterator it(dir_, err_code), end;
+       it != end && !err_code; it.increment(err_code)) {
+    if (llvm::sys::path::extension(it->path()) != ".dvc")
+      continue;
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(it->path(), status))
+      continue;
+    entries.push_back(
+        {it->path(), status.getSize(), status.getLastModificationTime()});
+    bytes_ += status.getSize();
+  }
+  if (bytes_ <= max_bytes_)
+    return;
+
+  // least recently used first
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.used < b.used; });
+  for (const Entry& entry : entries) {
+    if (bytes_ <= max_bytes_)
+      break;
+    if (!llvm::sys::fs::remove(entry.path)) {
+      bytes_ -= entry.size;
+      ++evicted_;
+    }
+  }
+}
+
+void FunctionCache::printStats(llvm::raw_ostream& os) const {
+  const size_t lookups = hits_ + misses_;
+  os << llvm::format("cache: %zu hits, %zu misses (%.1f%% hit rate), ",
+                     hits_, misses_,
+                     lookups ? 100.0 * hits_ / lookups : 0.0)
+     << evicted_ << " evicted, " << bytes_ << " of " << max_bytes_
+     << " bytes used\n";
+}
+
+}  // namespace deviant
@@ -1,7 +1,376 @@
 #include "lexer.h"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iostream>
+
 #include "token.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define DEVIANT_LEXER_SSE2
+#endif
+
 namespace deviant {
-Lexer::Lexer(const std::string& src) : index_(0), str_(src) {}
+namespace {
+
+// ASCII-only classification, independent of the C locale
+inline bool isSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool isDigit(char c) {
+  return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline bool isAlpha(char c) {
+  return static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+}
+
+inline bool isAlnum(char c) {
+  return isAlpha(c) || isDigit(c);
+}
+
+// Keywords are looked up through a perfect hash on the first character, the
+// last character and the length. Adding a keyword that collides trips the
+// static_assert below; pick another hash or grow the table in that case.
+struct Keyword {
+  std::string_view text;
+  TokenType type;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"ret", TokenType::RETURN}, {"var", TokenType::VAR},
+    {"if", TokenType::IF},      {"else", TokenType::ELSE},
+    {"fn", TokenType::FN},      {"int", TokenType::INT},
+    {"while", TokenType::WHILE}, {"for", TokenType::FOR},
+    {"i32x4", TokenType::I32X4}, {"i32x8", TokenType::I32X8},
+    {"f32x8", TokenType::F32X8}, {"float", TokenType::FLOAT},
+    {"inline", TokenType::INLINE}, {"noinline", TokenType::NOINLINE},
+    {"export", TokenType::EXPORT}, {"tail", TokenType::TAIL},
+};
+
+constexpr size_t kKeywordTableSize = 32;
+constexpr size_t kMinKeywordLength = 2;
+constexpr size_t kMaxKeywordLength = 8;
+
+constexpr size_t keywordHash(std::string_view word) {
+  return (3 * (static_cast<unsigned char>(word.front()) +
+               static_cast<unsigned char>(word.back())) +
+          word.size()) &
+         (kKeywordTableSize - 1);
+}
+
+constexpr std::array<Keyword, kKeywordTableSize> kKeywordTable = [] {
+  std::array<Keyword, kKeywordTableSize> table{};
+  for (const Keyword& keyword : kKeywords) {
+    table[keywordHash(keyword.text)] = keyword;
+  }
+  return table;
+}();
+
+constexpr bool isPerfectKeywordHash() {
+  for (const Keyword& keyword : kKeywords) {
+    if (keyword.text.size() < kMinKeywordLength ||
+        keyword.text.size() > kMaxKeywordLength ||
+        kKeywordTable[keywordHash(keyword.text)].text != keyword.text) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(isPerfectKeywordHash(), "keyword hash has collisions");
+
+inline TokenType lookupKeyword(std::string_view word) {
+  if (word.size() < kMinKeywordLength || word.size() > kMaxKeywordLength) {
+    return TokenType::IDENTIFIER;
+  }
+  const Keyword& keyword = kKeywordTable[keywordHash(word)];
+  return keyword.text == word ? keyword.type : TokenType::IDENTIFIER;
+}
+
+// Per-byte masks of 16 (SSE2) or 32 (AVX2) characters. Bytes >= 0x80 are
+// negative as signed chars and therefore never match a range.
+#if defined(__AVX2__)
+inline uint32_t spaceMask32(const char* p) {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  const __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+  const __m256i ctrl =
+      _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                       _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+  return static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_or_si256(space, ctrl)));
+}
+
+inline uint32_t alnumMask32(const char* p) {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  const __m256i alpha =
+      _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                       _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+  const __m256i digit =
+      _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                       _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+  return static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_or_si256(alpha, digit)));
+}
+#endif
+
+#if defined(DEVIANT_LEXER_SSE2)
+inline uint32_t spaceMask16(const char* p) {
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  const __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+  const __m128i ctrl =
+      _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                    _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(space, ctrl)));
+}
+
+inline uint32_t alnumMask16(const char* p) {
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  const __m128i alpha =
+      _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                    _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+  const __m128i digit =
+      _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                    _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(alpha, digit)));
+}
+#endif
+
+// skip a run of whitespace, return the first non-space character
+const char* skipSpaces(const char* p, const char* end) {
+  if (p == end || !isSpace(*p)) {
+    return p;
+  }
+#if defined(__AVX2__)
+  while (end - p >= 32) {
+    const uint32_t rest = ~spaceMask32(p);
+    if (rest) {
+      return p + std::countr_zero(rest);
+    }
+    p += 32;
+  }
+#endif
+#if defined(DEVIANT_LEXER_SSE2)
+  while (end - p >= 16) {
+    const uint32_t rest = ~spaceMask16(p) & 0xFFFF;
+    if (rest) {
+      return p + std::countr_zero(rest);
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && isSpace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// skip a run of [A-Za-z0-9], return the first character past it
+const char* skipAlnum(const char* p, const char* end) {
+#if defined(__AVX2__)
+  while (end - p >= 32) {
+    const uint32_t rest = ~alnumMask32(p);
+    if (rest) {
+      return p + std::countr_zero(rest);
+    }
+    p += 32;
+  }
+#endif
+#if defined(DEVIANT_LEXER_SSE2)
+  while (end - p >= 16) {
+    const uint32_t rest = ~alnumMask16(p) & 0xFFFF;
+    if (rest) {
+      return p + std::countr_zero(rest);
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && isAlnum(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+}  // namespace
+
+Lexer::Lexer(std::string_view src, Interner& interner)
+    : interner_(interner), str_(src), index_(0) {
+  // scanToken stores offsets in 32 bits
+  if (src.size() > kMaxSourceSize) {
+    std::cerr << "Deviant Error: the source has " << src.size()
+              << " bytes, more than the " << kMaxSourceSize
+              << " bytes a token offset can address" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void Lexer::tokenize() {
+  ScopedTimer timer("phase", "lex");
+  Token token;
+  while (scanToken(token)) {
+    addToken(token);
+  }
+}
+
+const Token* Lexer::stream(size_t i) {
+  static_assert((kStreamWindow & (kStreamWindow - 1)) == 0,
+                "stream window must be a power of two");
+
+  Token token;
+  if (scanned_ <= i && !exhausted_) {
+    TimeAccumulator::Scope timer(scan_time_);
+    while (scanned_ <= i && !exhausted_) {
+      if (!scanToken(token)) {
+        exhausted_ = true;
+        break;
+      }
+      window_[scanned_ & (kStreamWindow - 1)] = token;
+      ++scanned_;
+    }
+  }
+
+  if (i >= scanned_)  // past the end, or a negative offset wrapped around
+    return nullptr;
+  if (scanned_ - i > kStreamWindow) {
+    std::cerr << "Deviant Error: token " << i
+              << " left the stream window of " << kStreamWindow << " tokens"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return &window_[i & (kStreamWindow - 1)];
+}
+
+bool Lexer::scanToken(Token& token) {
+  const char* const begin = str_.data();
+  const char* const end = begin + str_.size();
+  const char* p = begin + index_;
+
+  // whitespace and line comments
+  for (;;) {
+    p = skipSpaces(p, end);
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+      const void* newline = std::memchr(p, '\n', end - p);
+      p = newline ? static_cast<const char*>(newline) + 1 : end;
+      continue;
+    }
+    break;
+  }
+
+  if (p == end || *p == '\0') {
+    index_ = p - begin;
+    return false;
+  }
+
+  const char* const start = p;
+  const char c = *p++;
+
+  // one- or two-character operator depending on the next character
+  auto select = [&](char next, TokenType pair, TokenType single) {
+    if (p < end && *p == next) {
+      ++p;
+      return pair;
+    }
+    return single;
+  };
+
+  TokenType type;
+  if (isAlpha(c)) {
+    p = skipAlnum(p, end);
+    type = lookupKeyword(std::string_view(start, p - start));
+  } else if (isDigit(c)) {
+    while (p < end && isDigit(*p)) {
+      ++p;
+    }
+    type = TokenType::INT_LIT;
+    if (end - p >= 2 && p[0] == '.' && isDigit(p[1])) {  // 1.5
+      p += 2;
+      while (p < end && isDigit(*p)) {
+        ++p;
+      }
+      type = TokenType::FLOAT_LIT;
+    }
+  } else {
+    switch (c) {
+      case '(':
+        type = TokenType::OPEN_PAREN;
+        break;
+      case ')':
+        type = TokenType::CLOSE_PAREN;
+        break;
+      case ',':
+        type = TokenType::COMMA;
+        break;
+      case ':':
+        type = TokenType::COLON;
+        break;
+      case ';':
+        type = TokenType::SEMICOLON;
+        break;
+      case '{':
+        type = TokenType::OPEN_CURLY;
+        break;
+      case '}':
+        type = TokenType::CLOSE_CURLY;
+        break;
+      case '[':
+        type = TokenType::OPEN_BRACKET;
+        break;
+      case ']':
+        type = TokenType::CLOSE_BRACKET;
+        break;
+      case '+':
+        type = TokenType::PLUS;
+        break;
+      case '*':
+        type = TokenType::STAR;
+        break;
+      case '/':
+        type = TokenType::FSLASH;
+        break;
+      case '-':
+        type = select('>', TokenType::FN_TYPE, TokenType::MINUS);
+        break;
+      case '=':
+        type = select('=', TokenType::EQ, TokenType::ASSIGNMENT);
+        break;
+      case '<':
+        type = select('=', TokenType::LE, TokenType::LT);
+        break;
+      case '>':
+        type = select('=', TokenType::GE, TokenType::GT);
+        break;
+      case '!':
+        type = select('=', TokenType::NE, TokenType::EXCLAMATION);
+        break;
+      case '@':
+        type = TokenType::AT;
+        break;
+      default:
+        std::cerr << "You messed up!" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (static_cast<size_t>(p - start) > kMaxTokenLength) {
+    std::cerr << "Deviant Error: the token at offset " << (start - begin)
+              << " is longer than " << kMaxTokenLength << " bytes"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  token.setType(type);
+  token.length = static_cast<uint32_t>(p - start);
+  token.offset = static_cast<uint32_t>(start - begin);
+  token.symbol = (type == TokenType::IDENTIFIER)
+                     ? interner_.intern(std::string_view(start, p - start))
+                     : kNoSymbol;
+  index_ = p - begin;
+  return true;
+}
 
-}  // namespace deviant
\ No newline at end of file
+}  // namespace deviant
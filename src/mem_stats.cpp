@@ -0,0 +1,251 @@
+#include "mem_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace deviant {
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_bytes{0};
+std::atomic<int64_t> g_live{0};
+std::atomic<int64_t> g_peak{0};  // reset at each phase start, see beginPhase
+
+// size the allocator really reserved; the same on allocation and free, so
+// live bytes balance without storing a header in front of every block
+size_t usableSize(void* ptr) {
+#if defined(__APPLE__)
+  return malloc_size(ptr);
+#elif defined(_WIN32)
+  return _msize(ptr);
+#else
+  return malloc_usable_size(ptr);
+#endif
+}
+
+void raisePeak(int64_t live) {
+  int64_t peak = g_peak.load(std::memory_order_relaxed);
+  while (live > peak &&
+         !g_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+#if defined(__linux__)
+// value in bytes of a "Key:   123 kB" line of /proc/self/status; read with
+// plain system calls so that sampling does not allocate
+int64_t procStatus(const char* key) {
+  char buffer[4096];
+  int fd = ::open("/proc/self/status", O_RDONLY);
+  if (fd < 0)
+    return -1;
+  ssize_t size = ::read(fd, buffer, sizeof(buffer) - 1);
+  ::close(fd);
+  if (size <= 0)
+    return -1;
+  buffer[size] = '\0';
+
+  const char* line = std::strstr(buffer, key);
+  if (!line)
+    return -1;
+  return std::strtoll(line + std::strlen(key), nullptr, 10) * 1024;
+}
+#endif
+
+int64_t peakRss() {
+#if defined(__linux__)
+  return procStatus("VmHWM:");
+#elif defined(_WIN32)
+  return -1;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#if defined(__APPLE__)
+  return usage.ru_maxrss;  // bytes
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// restart the high-water mark at the current RSS, where the kernel allows
+// it (Linux 4.0+); elsewhere phases see the peak of the whole process
+void resetPeakRss() {
+#if defined(__linux__)
+  int fd = ::open("/proc/self/clear_refs", O_WRONLY);
+  if (fd >= 0) {
+    (void)!::write(fd, "5", 1);
+    ::close(fd);
+  }
+#endif
+}
+
+struct OpenPhase {
+  size_t index;  // into g_phases
+  uint64_t allocations;
+  uint64_t bytes;
+  int64_t outer_peak;  // peak live bytes of the enclosing phase so far
+  int64_t rss_seen;    // RSS peaks of nested phases and before them
+};
+
+std::vector<MemStats::Phase> g_phases;
+std::vector<OpenPhase> g_open;
+int64_t g_rss_peak = -1;  // of finished phases, for total()
+
+}  // namespace
+
+void MemStats::enable() {
+  g_phases.reserve(64);
+  g_open.reserve(16);
+  enabled_ = true;
+}
+
+void MemStats::beginPhase(std::string_view name) {
+  OpenPhase open;
+  open.index = g_phases.size();
+  open.allocations = g_allocations.load(std::memory_order_relaxed);
+  open.bytes = g_bytes.load(std::memory_order_relaxed);
+  open.outer_peak = g_peak.load(std::memory_order_relaxed);
+  open.rss_seen = -1;
+  if (!g_open.empty()) {
+    // about to be reset for the nested phase
+    g_open.back().rss_seen = std::max(g_open.back().rss_seen, peakRss());
+  }
+
+  g_phases.push_back({std::string(name), static_cast<int>(g_open.size()), 0, 0,
+                      0, -1});
+  g_open.push_back(open);
+
+  g_peak.store(g_live.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+  resetPeakRss();
+}
+
+void MemStats::endPhase() {
+  if (g_open.empty())
+    return;
+  OpenPhase open = g_open.back();
+  g_open.pop_back();
+
+  Phase& phase = g_phases[open.index];
+  phase.allocations =
+      g_allocations.load(std::memory_order_relaxed) - open.allocations;
+  phase.bytes = g_bytes.load(std::memory_order_relaxed) - open.bytes;
+  phase.peak_live_bytes = g_peak.load(std::memory_order_relaxed);
+  phase.peak_rss_bytes = std::max(peakRss(), open.rss_seen);
+
+  // the enclosing phase keeps the higher of its own and these peaks
+  raisePeak(open.outer_peak);
+  if (!g_open.empty()) {
+    g_open.back().rss_seen =
+        std::max(g_open.back().rss_seen, phase.peak_rss_bytes);
+  }
+  g_rss_peak = std::max(g_rss_peak, phase.peak_rss_bytes);
+}
+
+const std::vector<MemStats::Phase>& MemStats::phases() { return g_phases; }
+
+MemStats::Phase MemStats::total() {
+  raisePeak(g_live.load(std::memory_order_relaxed));
+  return {"total",
+          0,
+          g_allocations.load(std::memory_order_relaxed),
+          g_bytes.load(std::memory_order_relaxed),
+          g_peak.load(std::memory_order_relaxed),
+          std::max(g_rss_peak, peakRss())};
+}
+
+void MemStats::onAllocate(void* ptr) {
+  const size_t size = usableSize(ptr);
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_bytes.fetch_add(size, std::memory_order_relaxed);
+  raisePeak(g_live.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+void MemStats::onFree(void* ptr) {
+  // blocks from before enable() were never added, and nothing tells them
+  // apart from counted ones; clamp so that freeing them cannot underflow
+  const int64_t size = usableSize(ptr);
+  int64_t live = g_live.load(std::memory_order_relaxed);
+  while (!g_live.compare_exchange_weak(live, std::max<int64_t>(live - size, 0),
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace deviant
+
+// Replacements of the global allocation functions. The array, nothrow and
+// sized forms all funnel into these two; over-aligned allocations keep the
+// library's versions and are not counted.
+namespace {
+
+void* countedNew(size_t size) {
+  if (size == 0) {
+    size = 1;
+  }
+  void* ptr;
+  while ((ptr = std::malloc(size)) == nullptr) {
+    std::new_handler handler = std::get_new_handler();
+    if (!handler)
+      return nullptr;
+    handler();
+  }
+  if (deviant::MemStats::enabled()) {
+    deviant::MemStats::onAllocate(ptr);
+  }
+  return ptr;
+}
+
+void countedDelete(void* ptr) noexcept {
+  if (!ptr)
+    return;
+  if (deviant::MemStats::enabled()) {
+    deviant::MemStats::onFree(ptr);
+  }
+  std::free(ptr);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (void* ptr = countedNew(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return ::operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return countedNew(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return countedNew(size);
+}
+
+void operator delete(void* ptr) noexcept { countedDelete(ptr); }
+void operator delete[](void* ptr) noexcept { countedDelete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedDelete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedDelete(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  countedDelete(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  countedDelete(ptr);
+}
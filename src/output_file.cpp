@@ -0,0 +1,64 @@
+#include "output_file.h"
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+OutputFile::~OutputFile() {
+  if (writer_.joinable() || fd_ >= 0) {
+    (void)wait();
+  }
+}
+
+bool OutputFile::open(const std::string& filename) {
+  filename_ = filename;
+  if (auto err_code = llvm::sys::fs::openFileForWrite(filename, fd_)) {
+    llvm::errs() << "Deviant Error: cannot write " << filename << ": "
+                 << err_code.message() << "\n";
+    fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+void OutputFile::commit() {
+  writer_ = std::thread(&OutputFile::write, this);
+}
+
+void OutputFile::write() {
+  // unbuffered: the whole buffer goes to the file in one write (the stream
+  // retries short writes) and the descriptor is closed afterwards
+  llvm::raw_fd_ostream out(fd_, /*shouldClose=*/true, /*unbuffered=*/true);
+  fd_ = -1;
+  out.write(buffer_.data(), buffer_.size());
+  out.close();
+  ok_ = !out.has_error();
+  out.clear_error();
+}
+
+bool OutputFile::wait() {
+  if (!writer_.joinable()) {
+    // never committed
+    if (fd_ >= 0) {
+      llvm::sys::Process::SafelyCloseFileDescriptor(fd_);
+      fd_ = -1;
+    }
+    return false;
+  }
+  writer_.join();
+  if (!ok_) {
+    llvm::errs() << "Deviant Error: failed to write " << filename_ << "\n";
+  }
+  return ok_;
+}
+
+}  // namespace deviant
@@ -1,73 +1,255 @@
 #include "parser.h"
+
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <optional>
+
 #include "token.h"
 
 namespace deviant {
-std::unique_ptr<Program> Parser::parse() {
-  std::unique_ptr<Program> program = std::make_unique<Program>();
-  while (index_ < lexer_.getTokens().size()) {
+Program* Parser::parse() {
+  Program* program = arena_.make<Program>(arena_);
+  while (peek() != TokenType::ILLEGAL) {
     auto statement_ptr = parseTopLevelStatement();
     if (statement_ptr) {
-      program->pushBack(std::move(statement_ptr));
+      program->pushBack(statement_ptr);
     }
     consume();
   }
+  lexer_.flushTimer();
   return program;
 }
 
-std::unique_ptr<Expression> Parser::parseExpression() {
-  if (peek().has_value() && peek().value().value.has_value()) {
-    Token token(peek().value());
-    const std::string& value(token.value.value());
-    switch (peek().value().type) {
-      case TokenType::INT_LIT:
-        return std::make_unique<Integer>(stoi(value));
-      case TokenType::IDENTIFIER:
-        if (peek(1).value().type == TokenType::OPEN_PAREN) {
-          // TODO: remove dangerous code
-          consume();
-          return parseFunctionCall();
-        } else {
-          return parseIdentifier();
-        }
-      default:
+namespace {
+
+constexpr int kPrefixPrecedence = 5;  // unary minus
+
+// binding strength of a binary operator, 0 for anything else
+int precedenceOf(TokenType type) {
+  switch (type) {
+    case TokenType::EQ:
+    case TokenType::NE:
+      return 1;
+    case TokenType::LT:
+    case TokenType::LE:
+    case TokenType::GT:
+    case TokenType::GE:
+      return 2;
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+      return 3;
+    case TokenType::STAR:
+    case TokenType::FSLASH:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+Expression* Parser::parseExpression(const int min_precedence) {
+  Expression* lhs = parsePrefixExpression();
+  while (lhs && peek(1) == TokenType::OPEN_BRACKET) {
+    lhs = parseSubscript(lhs);
+  }
+  // operators of equal precedence stop the loop: left associative
+  while (lhs && precedenceOf(peek(1)) > min_precedence) {
+    consume();  // last token of lhs
+    lhs = parseInfixExpression(lhs);
+  }
+  return lhs;
+}
+
+Expression* Parser::parseLiteral(bool negative) {
+  const std::string_view text(peekText());
+  const char* sign = negative ? "-" : "";
+  if (peek() == TokenType::INT_LIT) {
+    int64_t value = 0;
+    auto [ptr, err] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    value = negative ? -value : value;
+    if (err != std::errc() || value < std::numeric_limits<int>::min() ||
+        value > std::numeric_limits<int>::max()) {
+      error() << sign << text << " is out of the range of int\n";
+      return nullptr;
+    }
+    return arena_.make<Integer>(static_cast<int>(value));
+  }
+
+  float value = 0;
+  auto [ptr, err] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (err != std::errc()) {
+    error() << sign << text << " is out of the range of float\n";
+    return nullptr;
+  }
+  return arena_.make<Decimal>(negative ? -value : value);
+}
+
+Expression* Parser::parsePrefixExpression() {
+  switch (peek()) {
+    case TokenType::INT_LIT:
+    case TokenType::FLOAT_LIT:
+      return parseLiteral(false);
+    case TokenType::I32X4:
+    case TokenType::I32X8:
+    case TokenType::F32X8: {
+      if (peek(1) != TokenType::OPEN_PAREN)
         return nullptr;
+      const ValueType type = peek() == TokenType::I32X4   ? ValueType::I32X4
+                             : peek() == TokenType::I32X8 ? ValueType::I32X8
+                                                          : ValueType::F32X8;
+      return parseVectorOp(VectorOp::BUILD, type);
     }
-  } else
+    case TokenType::IDENTIFIER:
+      if (peek(1) == TokenType::OPEN_PAREN && peekText() == "shuffle") {
+        return parseVectorOp(VectorOp::SHUFFLE, ValueType::INT);
+      } else if (peek(1) == TokenType::OPEN_PAREN && peekText() == "reduce") {
+        return parseVectorOp(VectorOp::REDUCE, ValueType::INT);
+      } else if (peek(1) == TokenType::OPEN_PAREN) {
+        // TODO: remove dangerous code
+        consume();
+        return parseFunctionCall();
+      } else {
+        return parseIdentifier();
+      }
+    case TokenType::MINUS: {
+      consume();
+      // nothing binds tighter than the minus, so a literal is the operand
+      if (peek() == TokenType::INT_LIT || peek() == TokenType::FLOAT_LIT)
+        return parseLiteral(true);
+      Expression* operand = parseExpression(kPrefixPrecedence);
+      if (!operand)
+        return nullptr;
+      // folded, e.g. -(2 * 3)
+      if (operand->type() == AstNode::Type::INTEGER) {
+        const int value = static_cast<Integer*>(operand)->getValue();
+        return arena_.make<Integer>(
+            static_cast<int>(-static_cast<uint32_t>(value)));
+      }
+      if (operand->type() == AstNode::Type::DECIMAL) {
+        return arena_.make<Decimal>(
+            -static_cast<Decimal*>(operand)->getValue());
+      }
+      return arena_.make<Negation>(operand);
+    }
+    case TokenType::OPEN_PAREN: {
+      consume();
+      Expression* expr = parseExpression();
+      if (!expr || peek(1) != TokenType::CLOSE_PAREN)
+        return nullptr;
+      consume();  // last token of expr
+      return expr;
+    }
+    default:
+      return nullptr;
+  }
+}
+
+Expression* Parser::parseSubscript(Expression* base) {
+  consume();  // last token of base
+  consume();  // TokenType::OPEN_BRACKET
+  Expression* index = parseExpression();
+  if (!index || peek(1) != TokenType::CLOSE_BRACKET)
     return nullptr;
+  consume();  // last token of index
+  return arena_.make<Subscript>(base, index);
 }
 
-std::unique_ptr<Statement> Parser::parseTopLevelStatement() {
-  TokenType type =
-      peek().has_value() ? peek().value().type : TokenType::ILLEGAL;
+VectorOp* Parser::parseVectorOp(VectorOp::VecOp op, ValueType type) {
+  auto vector_op = arena_.make<VectorOp>(op, type, arena_);
 
-  switch (type) {
+  consume();  // name
+  if (peek(1) == TokenType::CLOSE_PAREN) {
+    consume();  // TokenType::OPEN_PAREN
+    return vector_op;
+  }
+  do {
+    consume();  // TokenType::OPEN_PAREN or TokenType::COMMA
+    Expression* arg = parseExpression();
+    if (!arg)
+      return nullptr;
+    vector_op->addArgument(arg);
+    consume();  // last token of the argument
+  } while (peek() == TokenType::COMMA);
+
+  if (peek() != TokenType::CLOSE_PAREN)
+    return nullptr;
+  return vector_op;
+}
+
+Expression* Parser::parseInfixExpression(Expression* lhs) {
+  const TokenType op = consume();
+  Expression* rhs = parseExpression(precedenceOf(op));
+  if (!rhs)
+    return nullptr;
+
+  switch (op) {
+    case TokenType::PLUS:
+      return makeArithmetic(arena_, lhs, ArithmeticOp::ADD, rhs);
+    case TokenType::MINUS:
+      return makeArithmetic(arena_, lhs, ArithmeticOp::SUB, rhs);
+    case TokenType::STAR:
+      return makeArithmetic(arena_, lhs, ArithmeticOp::MUL, rhs);
+    case TokenType::FSLASH:
+      return makeArithmetic(arena_, lhs, ArithmeticOp::DIV, rhs);
+    case TokenType::LT:
+      return makeComparison(arena_, lhs, ComparationOp::LT, rhs);
+    case TokenType::LE:
+      return makeComparison(arena_, lhs, ComparationOp::LE, rhs);
+    case TokenType::GT:
+      return makeComparison(arena_, lhs, ComparationOp::GT, rhs);
+    case TokenType::GE:
+      return makeComparison(arena_, lhs, ComparationOp::GE, rhs);
+    case TokenType::EQ:
+      return makeComparison(arena_, lhs, ComparationOp::EQ, rhs);
+    default:
+      return makeComparison(arena_, lhs, ComparationOp::NE, rhs);
+  }
+}
+
+Statement* Parser::parseTopLevelStatement() {
+  switch (peek()) {
     case TokenType::FN:
+    case TokenType::INLINE:
+    case TokenType::NOINLINE:
+    case TokenType::EXPORT:
       return parseFunctionStatement();
+    case TokenType::VAR:  // only arrays are global
+      if (peek(1) == TokenType::IDENTIFIER &&
+          peek(2) == TokenType::OPEN_BRACKET) {
+        consume();
+        return parseArrayDeclaration(true);
+      }
+      error() << "only arrays can be declared globally\n";
+      return nullptr;
     default:
       return nullptr;
   }
 }
 
-std::unique_ptr<Statement> Parser::parseStatement() {
-  TokenType type =
-      peek().has_value() ? peek().value().type : TokenType::ILLEGAL;
-
-  switch (type) {
+Statement* Parser::parseStatement() {
+  switch (peek()) {
     case TokenType::VAR:  // declaration of variable
-      if (peek(1).has_value() &&
-          peek(1).value().type == TokenType::IDENTIFIER) {
+      if (peek(1) == TokenType::IDENTIFIER) {
         consume();
-        return parseVariableDeclaration();  // deal with assignment later
+        if (peek(1) == TokenType::OPEN_BRACKET)
+          return parseArrayDeclaration(false);
+        return parseVariableDeclaration();
       } else {
         return nullptr;
       }
     case TokenType::IDENTIFIER:
-      if (peek(1).has_value() &&
-          peek(1).value().type == TokenType::OPEN_PAREN) {
+      if (peek(1) == TokenType::OPEN_PAREN) {
         consume();
         auto fn_call = parseFunctionCall();
         consume();
         return fn_call;
+      } else if (peek(1) == TokenType::OPEN_BRACKET) {
+        return parseElementAssignment();
       } else {  // TODO:
         consume();
         return parseAssignment();
@@ -76,6 +258,12 @@ std::unique_ptr<Statement> Parser::parseStatement() {
       return parseAssignment();
     case TokenType::IF:
       return parseIfStatement();
+    case TokenType::WHILE:
+      return parseWhileStatement();
+    case TokenType::FOR:
+      return parseForStatement();
+    case TokenType::AT:
+      return parseAnnotatedStatement();
     case TokenType::RETURN:
       return parseReturnStatement();
     default:
@@ -83,58 +271,122 @@ std::unique_ptr<Statement> Parser::parseStatement() {
   }
 }
 
-std::unique_ptr<Identifier> Parser::parseIdentifier() {
-  auto identifier = std::make_unique<Identifier>(peek().value().value.value());
+Identifier* Parser::parseIdentifier() {
+  auto identifier = arena_.make<Identifier>(peekSymbol());
 
   return identifier;
 }
 
-std::unique_ptr<VariableDeclaration> Parser::parseVariableDeclaration() {
-  if (peek().has_value() && peek().value().value.has_value()) {
-    auto identifier =
-        std::make_unique<Identifier>(peek().value().value.value());
+VariableDeclaration* Parser::parseVariableDeclaration() {
+  if (peek() == TokenType::IDENTIFIER) {
+    auto identifier = arena_.make<Identifier>(peekSymbol());
 
-    std::unique_ptr<Expression> expr(nullptr);
+    Expression* expr = nullptr;
     consume();
-    auto token_type = peek().value().type;
-    switch (token_type) {
+    switch (peek()) {
       case TokenType::SEMICOLON:
         break;
-      case TokenType::ASSIGNMENT:  // TODO:
-        --index_;
+      case TokenType::ASSIGNMENT:
+        consume();  // TokenType::ASSIGNMENT
+        expr = parseExpression();
+        if (!expr)
+          return nullptr;
+        consume();  // last token of the value
+        if (peek() != TokenType::SEMICOLON)
+          return nullptr;
         break;
       default:
         return nullptr;
     }
-    auto var_decl = std::make_unique<VariableDeclaration>(std::move(identifier),
-                                                          std::move(expr));
+    auto var_decl = arena_.make<VariableDeclaration>(identifier, expr);
     return var_decl;
   } else {
     return nullptr;
   }
 }
 
-std::unique_ptr<Assignment> Parser::parseAssignment() {
-  auto assign = std::make_unique<Assignment>();
+Assignment* Parser::parseAssignment() {
+  auto assign = arena_.make<Assignment>();
 
   // TODO: peek(-1) is dangerous
-  assign->setVarname(peek(-1).value().value.value());
+  assign->setVarname(peekSymbol(-1));
   consume();
 
   auto expr = parseExpression();
-  assign->setExpression(std::move(expr));
+  assign->setExpression(expr);
 
   consume();
 
   return assign;
 }
 
-std::unique_ptr<Block> Parser::parseBlock() {
-  auto block = std::make_unique<Block>();
+Assignment* Parser::parseElementAssignment() {
+  auto assign = arena_.make<Assignment>();
+  assign->setVarname(peekSymbol());
+  consume();  // name
+  consume();  // TokenType::OPEN_BRACKET
+
+  Expression* index = parseExpression();
+  if (!index || peek(1) != TokenType::CLOSE_BRACKET ||
+      peek(2) != TokenType::ASSIGNMENT)
+    return nullptr;
+  assign->setIndex(index);
+  consume();  // last token of index
+  consume();  // TokenType::CLOSE_BRACKET
+  consume();  // TokenType::ASSIGNMENT
+
+  assign->setExpression(parseExpression());
+  consume();  // last token of the value
+
+  return assign;
+}
+
+ArrayDeclaration* Parser::parseArrayDeclaration(bool global) {
+  const Symbol name = peekSymbol();
+  consume();  // name
+  consume();  // TokenType::OPEN_BRACKET
+
+  std::string_view text(peekText());
+  uint32_t length = 0;
+  auto [ptr, err] =
+      std::from_chars(text.data(), text.data() + text.size(), length);
+  if (peek() != TokenType::INT_LIT || err != std::errc() || length == 0 ||
+      peek(1) != TokenType::CLOSE_BRACKET) {
+    error() << "array length must be a positive integer, not " << text
+            << "\n";
+    return nullptr;
+  }
+  auto array = arena_.make<ArrayDeclaration>(name, length, global, arena_);
+  consume();  // TokenType::INT_LIT
+  consume();  // TokenType::CLOSE_BRACKET
+
+  if (peek() == TokenType::ASSIGNMENT) {
+    consume();  // TokenType::ASSIGNMENT
+    if (peek() != TokenType::OPEN_BRACKET)
+      return nullptr;
+    do {
+      consume();  // TokenType::OPEN_BRACKET or TokenType::COMMA
+      Expression* value = parseExpression();
+      if (!value)
+        return nullptr;
+      array->addValue(value);
+      consume();  // last token of the value
+    } while (peek() == TokenType::COMMA);
+    if (peek() != TokenType::CLOSE_BRACKET)
+      return nullptr;
+    consume();  // TokenType::CLOSE_BRACKET
+  }
+  if (peek() != TokenType::SEMICOLON)
+    return nullptr;
+  return array;
+}
+
+Block* Parser::parseBlock() {
+  auto block = arena_.make<Block>(arena_);
 
   auto stmt = parseStatement();
   while (stmt) {
-    block->insertStatement(std::move(stmt));
+    block->insertStatement(stmt);
     consume();
     stmt = parseStatement();
   }
@@ -142,29 +394,33 @@ std::unique_ptr<Block> Parser::parseBlock() {
   return block;
 }
 
-std::unique_ptr<ReturnStatement> Parser::parseReturnStatement() {
+ReturnStatement* Parser::parseReturnStatement() {
   consume();
-  auto ret_stmt = std::make_unique<ReturnStatement>(parseExpression());
+  const bool tail = peek() == TokenType::TAIL;
+  if (tail) {
+    consume();
+  }
+  Expression* expr = parseExpression();
+  if (tail && (!expr || expr->type() != AstNode::Type::CALL)) {
+    error() << "ret tail takes a function call\n";
+    return nullptr;
+  }
+  auto ret_stmt = arena_.make<ReturnStatement>(expr, tail);
 
-  if (consume().type == TokenType::SEMICOLON)
+  if (consume() == TokenType::SEMICOLON)
     return nullptr;
 
   return ret_stmt;
 }
 
-std::unique_ptr<ComparationOp> Parser::parseInfixStatement() {
-  return nullptr;
-  // return std::unique_ptr<ComparationOp>();
-}
-
-std::unique_ptr<IfStatement> Parser::parseIfStatement() {
-  std::unique_ptr<IfStatement> if_stmt = std::make_unique<IfStatement>();
+IfStatement* Parser::parseIfStatement() {
+  IfStatement* if_stmt = arena_.make<IfStatement>();
 
   // condition
   consume();  // TokenType::IF
   consume();  // TokenType::OPEN_PAREN
   if_stmt->setCondition(parseExpression());
-  consume();  // condition
+  consume();  // last token of the condition
   consume();  // TokenType::CLOSE_PAREN
 
   // then
@@ -172,52 +428,241 @@ std::unique_ptr<IfStatement> Parser::parseIfStatement() {
   if_stmt->setThenBlock(parseBlock());
 
   // else
-  if (peek().has_value() && peek().value().type == TokenType::ELSE) {
+  if (peek(1) == TokenType::ELSE) {
     consume();  // TokenType::CLOSE_CURLY
     consume();  // TokenType::ELSE
-    consume();  // TokenType::OPEN_CURLY
-    if_stmt->setElseBlock(parseBlock());
-    // consume();  // TokenType::CLOSE_CURLY
+    if (peek() == TokenType::IF) {  // else if: a block of just that if
+      Block* else_block = arena_.make<Block>(arena_);
+      IfStatement* else_if = parseIfStatement();
+      if (!else_if)
+        return nullptr;
+      else_block->insertStatement(else_if);
+      if_stmt->setElseBlock(else_block);
+    } else {
+      consume();  // TokenType::OPEN_CURLY
+      if_stmt->setElseBlock(parseBlock());
+    }
   }
 
   return if_stmt;
 }
 
-std::unique_ptr<FunctionStatement> Parser::parseFunctionStatement() {
-  consume();
-  if (peek().value().value.has_value()) {
-    auto fn = std::make_unique<FunctionStatement>(peek().value().value.value());
+LoopStatement* Parser::parseWhileStatement() {
+  LoopStatement* loop = arena_.make<LoopStatement>(arena_);
+
+  consume();  // TokenType::WHILE
+  consume();  // TokenType::OPEN_PAREN
+  loop->setCondition(parseExpression());
+  consume();  // last token of the condition
+  consume();  // TokenType::CLOSE_PAREN
+
+  consume();  // TokenType::OPEN_CURLY
+  loop->setBody(parseBlock());
+  return loop;
+}
+
+LoopStatement* Parser::parseForStatement() {
+  LoopStatement* loop = arena_.make<LoopStatement>(arena_);
+
+  consume();  // TokenType::FOR
+  consume();  // TokenType::OPEN_PAREN
 
-    // TODO: parameters
+  // init: var i = 0, i = 0 or nothing
+  if (peek() == TokenType::VAR) {
     consume();
+    VariableDeclaration* var_decl = parseVariableDeclaration();
+    if (!var_decl)
+      return nullptr;
+    loop->addInit(var_decl);
+  } else if (peek() == TokenType::IDENTIFIER &&
+             peek(1) == TokenType::ASSIGNMENT) {
     consume();
+    loop->addInit(parseAssignment());
+  }
+  if (peek() != TokenType::SEMICOLON)
+    return nullptr;
+  consume();  // TokenType::SEMICOLON
+
+  // condition, none to loop forever
+  if (peek() != TokenType::SEMICOLON) {
+    loop->setCondition(parseExpression());
+    consume();  // last token of the condition
+  }
+  if (peek() != TokenType::SEMICOLON)
+    return nullptr;
+  consume();  // TokenType::SEMICOLON
+
+  // step: an assignment or nothing
+  if (peek() == TokenType::IDENTIFIER && peek(1) == TokenType::ASSIGNMENT) {
     consume();
+    loop->setStep(parseAssignment());
+  }
+  if (peek() != TokenType::CLOSE_PAREN)
+    return nullptr;
+  consume();  // TokenType::CLOSE_PAREN
 
-    if (peek().value().type != TokenType::FN_TYPE)
+  consume();  // TokenType::OPEN_CURLY
+  loop->setBody(parseBlock());
+  return loop;
+}
+
+Statement* Parser::parseAnnotatedStatement() {
+  consume();  // TokenType::AT
+  const std::string_view name = peekText();
+  consume();  // name
+
+  uint32_t unroll_count = 0;
+  if (name == "unroll") {  // @unroll(N)
+    if (peek() != TokenType::OPEN_PAREN || peek(1) != TokenType::INT_LIT ||
+        peek(2) != TokenType::CLOSE_PAREN) {
+      error() << "@unroll needs a count, as in @unroll(4)\n";
       return nullptr;
+    }
+    consume();  // TokenType::OPEN_PAREN
+    std::string_view text(peekText());
+    auto [ptr, err] = std::from_chars(text.data(), text.data() + text.size(),
+                                      unroll_count);
+    if (err != std::errc() || unroll_count == 0) {
+      error() << "bad unroll count " << text << "\n";
+      return nullptr;
+    }
+    consume();  // TokenType::INT_LIT
+    consume();  // TokenType::CLOSE_PAREN
+  }
 
-    // TODO: return type
-    consume();
-    consume();
+  // annotations stack, as in @unroll(4) @vectorize for (...)
+  Statement* stmt =
+      peek() == TokenType::AT ? parseAnnotatedStatement() : parseStatement();
+  if (!stmt)
+    return nullptr;
 
-    if (consume().type == TokenType::OPEN_CURLY) {
-      fn->setBlock(parseBlock());
+  if (name == "likely" || name == "unlikely") {
+    if (stmt->type() != AstNode::Type::CONDITIONAL) {
+      error() << "@" << name << " must precede an if\n";
+      return nullptr;
     }
-    return fn;
-  } else {
+    static_cast<IfStatement*>(stmt)->setHint(
+        name == "likely" ? IfStatement::Hint::LIKELY
+                         : IfStatement::Hint::UNLIKELY);
+    return stmt;
+  }
+
+  if (name == "unroll" || name == "vectorize" || name == "novectorize") {
+    if (stmt->type() != AstNode::Type::LOOP) {
+      error() << "@" << name << " must precede a loop\n";
+      return nullptr;
+    }
+    auto loop = static_cast<LoopStatement*>(stmt);
+    if (name == "unroll") {
+      loop->setUnrollCount(unroll_count);
+    } else {
+      loop->setVectorize(name == "vectorize"
+                             ? LoopStatement::Vectorize::ENABLE
+                             : LoopStatement::Vectorize::DISABLE);
+    }
+    return stmt;
+  }
+
+  error() << "unknown annotation @" << name << "\n";
+  return nullptr;
+}
+
+namespace {
+
+// the type a type keyword spells
+std::optional<ValueType> valueTypeOf(TokenType type) {
+  switch (type) {
+    case TokenType::INT:
+      return ValueType::INT;
+    case TokenType::FLOAT:
+      return ValueType::FLOAT;
+    case TokenType::I32X4:
+      return ValueType::I32X4;
+    case TokenType::I32X8:
+      return ValueType::I32X8;
+    case TokenType::F32X8:
+      return ValueType::F32X8;
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
+FunctionStatement* Parser::parseFunctionStatement() {
+  // inline, noinline and export in any order before fn
+  auto inlining = FunctionStatement::Inlining::DEFAULT;
+  bool exported = false;
+  for (;; consume()) {
+    if (peek() == TokenType::INLINE) {
+      inlining = FunctionStatement::Inlining::ALWAYS;
+    } else if (peek() == TokenType::NOINLINE) {
+      inlining = FunctionStatement::Inlining::NEVER;
+    } else if (peek() == TokenType::EXPORT) {
+      exported = true;
+    } else {
+      break;
+    }
+  }
+  if (peek() != TokenType::FN)
+    return nullptr;
+  consume();
+  if (peek() != TokenType::IDENTIFIER || peek(1) != TokenType::OPEN_PAREN)
     return nullptr;
+
+  const std::string_view name = peekText();
+  auto fn = arena_.make<FunctionStatement>(peekSymbol(), arena_);
+  fn->setInlining(inlining);
+  fn->setExported(exported);
+  consume();  // name
+
+  // (name: type, ...)
+  if (peek(1) == TokenType::CLOSE_PAREN) {
+    consume();  // TokenType::OPEN_PAREN
+  }
+  while (peek() != TokenType::CLOSE_PAREN) {
+    consume();  // TokenType::OPEN_PAREN or TokenType::COMMA
+    std::optional<ValueType> type = valueTypeOf(peek(2));
+    if (peek() != TokenType::IDENTIFIER || peek(1) != TokenType::COLON ||
+        !type || (peek(3) != TokenType::COMMA &&
+                  peek(3) != TokenType::CLOSE_PAREN)) {
+      error() << "expected name: type in the parameters of " << name << "\n";
+      return nullptr;
+    }
+    fn->addParameter(peekSymbol(), *type);
+    consume();  // name
+    consume();  // TokenType::COLON
+    consume();  // type
   }
+  consume();  // TokenType::CLOSE_PAREN
+
+  std::optional<ValueType> return_type = valueTypeOf(peek(1));
+  if (peek() != TokenType::FN_TYPE || !return_type) {
+    error() << "expected -> and the return type of " << name << "\n";
+    return nullptr;
+  }
+  fn->setReturnType(*return_type);
+  consume();  // TokenType::FN_TYPE
+  consume();  // return type
+
+  if (peek() != TokenType::OPEN_CURLY) {
+    error() << "expected { after the signature of " << name << "\n";
+    return nullptr;
+  }
+  consume();  // TokenType::OPEN_CURLY
+  fn->setBlock(parseBlock());
+  return fn;
 }
 
-std::unique_ptr<FunctionCall> Parser::parseFunctionCall() {
-  auto fn_call = std::make_unique<FunctionCall>(peek(-1).value().value.value());
+FunctionCall* Parser::parseFunctionCall() {
+  auto fn_call = arena_.make<FunctionCall>(peekSymbol(-1), arena_);
 
   consume();
   // prase arguments
-  while (peek().has_value() && peek().value().type != TokenType::CLOSE_PAREN) {
+  while (peek() != TokenType::ILLEGAL && peek() != TokenType::CLOSE_PAREN) {
     fn_call->addArgument(parseExpression());
     consume();
-    if (peek().has_value() && peek().value().type == TokenType::COMMA) {
+    if (peek() == TokenType::COMMA) {
       consume();  // TODO: ,) should be forbidden
     }
   }
@@ -227,15 +672,29 @@ std::unique_ptr<FunctionCall> Parser::parseFunctionCall() {
   return fn_call;
 }
 
-std::optional<Token> Parser::peek(const int offset) const {
-  const auto& tokens = lexer_.getTokens();
-  if (index_ + offset >= tokens.size())
-    return std::nullopt;
-  else
-    return tokens[index_ + offset];
+TokenType Parser::peek(const int offset) {
+  const Token* token = lexer_.stream(index_ + offset);
+  return token ? token->type() : TokenType::ILLEGAL;
+}
+
+std::string_view Parser::peekText(const int offset) {
+  const Token* token = lexer_.stream(index_ + offset);
+  return token ? lexer_.text(*token) : std::string_view();
+}
+
+Symbol Parser::peekSymbol(const int offset) {
+  const Token* token = lexer_.stream(index_ + offset);
+  return token ? token->symbol : kNoSymbol;
+}
+
+TokenType Parser::consume() {
+  TokenType type = peek();
+  ++index_;
+  return type;
 }
 
-const Token& Parser::consume() {
-  return lexer_.getTokens()[index_++];
+std::ostream& Parser::error() {
+  ++errors_;
+  return std::cerr << "Deviant Error: ";
 }
 }  // namespace deviant
\ No newline at end of file
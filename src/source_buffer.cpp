@@ -0,0 +1,95 @@
+#include "source_buffer.h"
+
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace deviant {
+
+SourceBuffer::~SourceBuffer() {
+  unmap();
+}
+
+void SourceBuffer::unmap() {
+#if !defined(_WIN32)
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+  mapped_ = false;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#if defined(_WIN32)
+bool SourceBuffer::load(const std::string& filename) {
+  unmap();
+  std::ostringstream content;
+  if (filename == "-") {
+    content << std::cin.rdbuf();
+  } else {
+    std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+    if (!ifs)
+      return false;
+    content << ifs.rdbuf();
+  }
+  fallback_ = std::move(content).str();
+  data_ = fallback_.data();
+  size_ = fallback_.size();
+  return true;
+}
+#else
+bool SourceBuffer::load(const std::string& filename) {
+  unmap();
+
+  const bool use_stdin = (filename == "-");
+  int fd = use_stdin ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      madvise(addr, st.st_size, MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(addr);
+      size_ = st.st_size;
+      mapped_ = true;
+      if (!use_stdin)
+        close(fd);
+      return true;
+    }
+  }
+
+  // pipes, empty files and anything mmap refuses
+  fallback_.clear();
+  char chunk[1 << 16];
+  ssize_t n;
+  while ((n = read(fd, chunk, sizeof(chunk))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (!use_stdin)
+        close(fd);
+      return false;
+    }
+    fallback_.append(chunk, n);
+  }
+  if (!use_stdin)
+    close(fd);
+
+  data_ = fallback_.data();
+  size_ = fallback_.size();
+  return true;
+}
+#endif
+
+}  // namespace deviant
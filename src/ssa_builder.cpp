@@ -0,0 +1,109 @@
+#include "ssa_builder.h"
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+namespace deviant {
+
+void SsaBuilder::seal(llvm::BasicBlock* block) {
+  if (!sealed_.insert(block).second)
+    return;
+  auto it = incomplete_.find(block);
+  if (it == incomplete_.end())
+    return;
+  auto phis = std::move(it->second);
+  incomplete_.erase(it);
+  for (auto& [var, phi] : phis) {
+    addOperands(var, phi);
+  }
+}
+
+void SsaBuilder::clear() {
+  defs_.clear();
+  sealed_.clear();
+  incomplete_.clear();
+  created_ = removed_ = 0;
+}
+
+llvm::Value* SsaBuilder::readRecursive(Variable* var,
+                                       llvm::BasicBlock* block) {
+  llvm::Value* value;
+  if (!sealed_.count(block)) {
+    // operands are added when the last predecessor is known
+    llvm::PHINode* phi = createPhi(var, block);
+    incomplete_[block].push_back({var, phi});
+    value = phi;
+  } else if (llvm::BasicBlock* pred = block->getSinglePredecessor()) {
+    value = read(var, pred);
+  } else if (llvm::pred_empty(block)) {
+    // read before any assignment, or in unreachable code
+    value = llvm::UndefValue::get(var->type);
+  } else {
+    // the phi is the definition while the predecessors are searched, which
+    // ends the recursion on cycles
+    llvm::PHINode* phi = createPhi(var, block);
+    write(var, block, phi);
+    value = addOperands(var, phi);
+  }
+  write(var, block, value);
+  return value;
+}
+
+llvm::PHINode* SsaBuilder::createPhi(Variable* var, llvm::BasicBlock* block) {
+  ++created_;
+  if (block->empty())
+    return llvm::PHINode::Create(var->type, 2, var->name, block);
+  return llvm::PHINode::Create(var->type, 2, var->name, &block->front());
+}
+
+llvm::Value* SsaBuilder::addOperands(Variable* var, llvm::PHINode* phi) {
+  // one operand per edge, so a block reached twice from the same
+  // predecessor is listed twice
+  for (llvm::BasicBlock* pred : llvm::predecessors(phi->getParent())) {
+    phi->addIncoming(read(var, pred), pred);
+  }
+  return tryRemoveTrivial(phi);
+}
+
+llvm::Value* SsaBuilder::tryRemoveTrivial(llvm::PHINode* phi) {
+  llvm::Value* same = nullptr;
+  for (llvm::Value* op : phi->incoming_values()) {
+    if (op == same || op == phi)
+      continue;
+    if (same)
+      return phi;  // merges at least two values
+    same = op;
+  }
+  if (!same) {
+    same = llvm::UndefValue::get(phi->getType());
+  }
+
+  // phis using this one may become trivial in turn
+  llvm::SmallVector<llvm::WeakVH, 4> users;
+  for (llvm::User* user : phi->users()) {
+    if (user != phi && llvm::isa<llvm::PHINode>(user)) {
+      users.push_back(user);
+    }
+  }
+
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+  ++removed_;
+
+  for (llvm::WeakVH& user : users) {
+    if (auto other = llvm::dyn_cast_or_null<llvm::PHINode>(user)) {
+      tryRemoveTrivial(other);
+    }
+  }
+  return same;
+}
+
+}  // namespace deviant
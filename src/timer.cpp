@@ -0,0 +1,166 @@
+#include "timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#endif
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "mem_stats.h"
+#include "output_file.h"
+
+namespace deviant {
+namespace {
+
+// small dense thread ids read better in trace viewers than native ones
+uint32_t threadId() {
+  static std::atomic<uint32_t> next{0};
+  thread_local uint32_t id = next++;
+  return id;
+}
+
+int64_t microseconds(Profiler::Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+// longest lists (functions, passes) are cut after this many entries
+constexpr size_t kReportEntries = 25;
+
+}  // namespace
+
+void Profiler::enable() {
+  get().origin_ = Clock::now();
+  get().main_thread_ = std::this_thread::get_id();
+  enabled_ = timing_ = true;
+}
+
+void Profiler::enableMemory() {
+  MemStats::enable();
+  get().main_thread_ = std::this_thread::get_id();
+  enabled_ = memory_ = true;
+}
+
+void Profiler::beginScope(const char* category, std::string_view name) {
+  if (memory_ && std::strcmp(category, "phase") == 0 &&
+      std::this_thread::get_id() == main_thread_) {
+    MemStats::beginPhase(name);
+  }
+}
+
+void Profiler::endScope(const char* category, std::string_view name,
+                        Clock::time_point start, Clock::time_point end) {
+  if (memory_ && std::strcmp(category, "phase") == 0 &&
+      std::this_thread::get_id() == main_thread_) {
+    MemStats::endPhase();
+  }
+  record(category, name, start, end);
+}
+
+Profiler& Profiler::get() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::record(const char* category, std::string_view name,
+                      Clock::time_point start, Clock::time_point end,
+                      bool in_trace) {
+  if (!timing_)
+    return;
+  Event event{category,
+              std::string(name),
+              microseconds(start - origin_),
+              microseconds(end - start),
+              threadId(),
+              in_trace};
+  std::lock_guard<std::mutex> lock(mutex_);
+  events_.push_back(std::move(event));
+}
+
+void Profiler::printReport(llvm::raw_ostream& os) {
+  struct Total {
+    int64_t us{0};
+    size_t count{0};
+  };
+  // categories in order of first appearance
+  std::vector<std::string_view> categories;
+  std::map<std::string_view, std::map<std::string_view, Total>> totals;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const Event& event : events_) {
+    if (!totals.count(event.category)) {
+      categories.push_back(event.category);
+    }
+    Total& total = totals[event.category][event.name];
+    total.us += event.duration_us;
+    ++total.count;
+  }
+
+  const double wall_ms = microseconds(Clock::now() - origin_) / 1000.0;
+  os << "===--- deviant time report (inclusive, " << llvm::format("%.3f", wall_ms)
+     << " ms wall) ---===\n";
+  for (std::string_view category : categories) {
+    std::vector<std::pair<std::string_view, Total>> entries(
+        totals[category].begin(), totals[category].end());
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.second.us > b.second.us;
+                     });
+
+    os << category << ":\n";
+    for (size_t i = 0; i < entries.size() && i < kReportEntries; ++i) {
+      const double ms = entries[i].second.us / 1000.0;
+      os << llvm::format("  %10.3f ms %5.1f%% %7zu  ", ms,
+                         wall_ms > 0 ? 100.0 * ms / wall_ms : 0.0,
+                         entries[i].second.count)
+         << entries[i].first << "\n";
+    }
+    if (entries.size() > kReportEntries) {
+      os << "  ... " << entries.size() - kReportEntries << " more\n";
+    }
+  }
+}
+
+bool Profiler::writeTrace(const std::string& filename) {
+  OutputFile file;
+  if (!file.open(filename))
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    llvm::json::OStream json(file.stream());
+    json.object([&] {
+      json.attributeArray("traceEvents", [&] {
+        for (const Event& event : events_) {
+          if (!event.in_trace)
+            continue;
+          json.object([&] {
+            json.attribute("name", event.name);
+            json.attribute("cat", event.category);
+            json.attribute("ph", "X");
+            json.attribute("ts", event.start_us);
+            json.attribute("dur", event.duration_us);
+            json.attribute("pid", 1);
+            json.attribute("tid", static_cast<int64_t>(event.thread));
+          });
+        }
+      });
+      json.attribute("displayTimeUnit", "ms");
+    });
+  }
+
+  file.commit();
+  return file.wait();
+}
+
+}  // namespace deviant
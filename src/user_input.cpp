@@ -1,5 +1,7 @@
 #include "user_input.h"
 
+#include <charconv>
+
 namespace deviant {
 namespace {
 enum class Option { HELP, VERSION, INCORRECT };
@@ -13,9 +15,37 @@ void printMessage(Option option) {
     case Option::HELP:
       printf("Usage:\n");
       printf("deviant filename -h -v -q path\n");
+      printf("deviant run filename [options]\n");
+      printf("\tfilename may be '-' to read the program from stdin.\n");
       printf("\t-h this help text.\n");
-      printf("\t-v be more verbose.\n");
+      printf("\t-v be more verbose, e.g. report arena usage and timings.\n");
       printf("\t-q be quiet.\n");
+      printf("\t-O0 -O1 -O2 -O3 -Os optimization level (default -O0).\n");
+      printf("\t-passes=<pipeline> run a custom pass pipeline instead.\n");
+      printf("\t--no-ssa keep local variables in stack slots instead of\n");
+      printf("\t     building SSA form directly.\n");
+      printf("\t--no-bounds-checks do not check array indices at run time.\n");
+      printf("\t--emit=bc|ll|obj write bitcode, textual IR or an object file\n");
+      printf("\t     to filename.bc/.ll/.o or the -o path (--emit: bc).\n");
+      printf("\t     Use --emit=ll for IR to read.\n");
+      printf("\t-c same as --emit=obj.\n");
+      printf("\t-o path output path; .bc, .ll and .o select the format,\n");
+      printf("\t     anything else builds an executable linked with the\n");
+      printf("\t     runtime. Without -o and --emit, bitcode goes to\n");
+      printf("\t     ./out.bc.\n");
+      printf("\t-j N compile and optimize on N threads (0: all cores).\n");
+      printf("\t     Functions are only inlined across threads by a short\n");
+      printf("\t     pass after merging, at -O2/-O3, and not at all for\n");
+      printf("\t     executables, which link each thread's object file.\n");
+      printf("\t--cache-dir=dir reuse compiled functions across runs.\n");
+      printf("\t     Each function is a thread's share then, see -j.\n");
+      printf("\t--cache-size=MB bound the cache (default 512).\n");
+      printf("\t--time-report time phases, functions and LLVM passes.\n");
+      printf("\t--trace=file.json write a Chrome/Perfetto trace.\n");
+      printf("\t--mem-stats[=file.json] allocations and peak memory per\n");
+      printf("\t     phase as JSON, on stderr without a file.\n");
+      printf("\trun: JIT-compile the program, call main and exit with its\n");
+      printf("\t     return value instead of writing out.bc.\n");
       break;
     case Option::VERSION:
       printf("deviant version 1.0.0\n");
@@ -29,8 +59,48 @@ void printMessage(Option option) {
   }
 }
 
+const char* extensionOf(Emit emit) {
+  switch (emit) {
+    case Emit::BC:
+      return ".bc";
+    case Emit::OBJ:
+      return ".o";
+    default:
+      return ".ll";
+  }
+}
+
+// foo/bar.dv -> foo/bar.bc
+std::string outputFilename(const std::string& filename, Emit emit) {
+  if (filename == "-")
+    return std::string("out") + extensionOf(emit);
+  return filename.substr(0, filename.find_last_of('.')) + extensionOf(emit);
+}
+
+// format implied by the extension of an -o path
+bool emitFromFilename(const std::string& filename, Emit& emit) {
+  for (Emit e : {Emit::LL, Emit::BC, Emit::OBJ}) {
+    const std::string extension = extensionOf(e);
+    if (filename.size() > extension.size() &&
+        filename.compare(filename.size() - extension.size(), extension.size(),
+                         extension) == 0) {
+      emit = e;
+      return true;
+    }
+  }
+  return false;
+}
+
+// "8" -> 8; false unless the whole text is a number
+bool parseNumber(const std::string& text, unsigned& jobs) {
+  auto [ptr, err] =
+      std::from_chars(text.data(), text.data() + text.size(), jobs);
+  return !text.empty() && err == std::errc() &&
+         ptr == text.data() + text.size();
+}
+
 bool isValidDvtFile(const std::string& filename) {
-  size_t location = filename.find_first_of('.');
+  size_t location = filename.find_last_of('.');
   std::string extension = filename.substr(location + 1, filename.size());
   return (extension == "dvt" || extension == "dv") ? true : false;
 }
@@ -47,23 +117,107 @@ bool UserInput::handleUserInput(int argc, char* argv[]) {
     printMessage(Option::HELP);
     return false;
   }
-  std::string arg(argv[1]);
-  if (argc == 2 && arg[0] == '-') {
-    // TODO: not correct here
-    const std::string& opt = (arg[1] == '-') ? (arg.substr(2, arg.size()))
-                                             : (arg.substr(1, arg.size()));
-
-    if (opt == "version") {
-      printMessage(Option::VERSION);
-    } else if (opt == "h" || opt == "help") {
-      printMessage(Option::HELP);
+
+  int first = 1;
+  if (std::string(argv[1]) == "run") {
+    options_.mode = Mode::RUN;
+    first = 2;
+  }
+
+  bool emit_given = false;
+  std::string output;
+  for (int i = first; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "-") {  // read the program from stdin
+      filename_ = arg;
+    } else if (arg[0] == '-') {
+      const std::string& opt = (arg[1] == '-') ? (arg.substr(2, arg.size()))
+                                               : (arg.substr(1, arg.size()));
+
+      if (opt == "version") {
+        printMessage(Option::VERSION);
+        return false;
+      } else if (opt == "h" || opt == "help") {
+        printMessage(Option::HELP);
+        return false;
+      } else if (opt == "v") {
+        options_.verbose = true;
+      } else if (opt == "O0") {
+        options_.opt_level = OptLevel::O0;
+      } else if (opt == "O1") {
+        options_.opt_level = OptLevel::O1;
+      } else if (opt == "O2") {
+        options_.opt_level = OptLevel::O2;
+      } else if (opt == "O3") {
+        options_.opt_level = OptLevel::O3;
+      } else if (opt == "Os") {
+        options_.opt_level = OptLevel::Os;
+      } else if (opt.rfind("passes=", 0) == 0) {
+        options_.passes = opt.substr(7);
+      } else if (opt == "no-ssa") {
+        options_.ssa = false;
+      } else if (opt == "no-bounds-checks") {
+        options_.bounds_checks = false;
+      } else if (opt == "c" || opt == "emit=obj") {
+        options_.emit = Emit::OBJ;
+        emit_given = true;
+      } else if (opt == "emit" || opt == "emit=bc") {
+        options_.emit = Emit::BC;
+        emit_given = true;
+      } else if (opt == "emit=ll") {
+        options_.emit = Emit::LL;
+        emit_given = true;
+      } else if (opt == "j" && i + 1 < argc) {
+        if (!parseNumber(argv[++i], options_.jobs)) {
+          printMessage(Option::INCORRECT);
+          return false;
+        }
+      } else if (opt[0] == 'j' && parseNumber(opt.substr(1), options_.jobs)) {
+        // -jN
+      } else if (opt == "mem-stats") {
+        options_.mem_stats = true;
+      } else if (opt.rfind("mem-stats=", 0) == 0) {
+        options_.mem_stats = true;
+        options_.mem_stats_file = opt.substr(10);
+      } else if (opt == "time-report") {
+        options_.time_report = true;
+      } else if (opt.rfind("trace=", 0) == 0) {
+        options_.trace_file = opt.substr(6);
+      } else if (opt.rfind("cache-dir=", 0) == 0) {
+        options_.cache_dir = opt.substr(10);
+      } else if (opt.rfind("cache-size=", 0) == 0) {
+        unsigned megabytes = 0;
+        if (!parseNumber(opt.substr(11), megabytes)) {
+          printMessage(Option::INCORRECT);
+          return false;
+        }
+        options_.cache_size = uint64_t(megabytes) << 20;
+      } else if (opt == "o" && i + 1 < argc) {
+        output = argv[++i];
+      } else {
+        printMessage(Option::INCORRECT);
+        return false;
+      }
+    } else if (isValidDvtFile(arg)) {  // filename
+      filename_ = arg;
     } else {
       printMessage(Option::INCORRECT);
+      return false;
     }
-  } else if (isValidDvtFile(arg)) {  // filename
-    filename_ = arg;
-    return true;
   }
-  return false;
+  if (filename_.empty())
+    return false;
+
+  if (options_.mode == Mode::COMPILE) {
+    if (emit_given) {
+      options_.output =
+          output.empty() ? outputFilename(filename_, options_.emit) : output;
+    } else if (!output.empty()) {
+      options_.output = output;
+      if (!emitFromFilename(output, options_.emit))
+        options_.mode = Mode::EXECUTABLE;
+    }
+  }
+  return true;
 }
 }  // namespace deviant
\ No newline at end of file
@@ -0,0 +1,34 @@
+# Runs `deviant run PROGRAM` and checks it against the first line of
+# PROGRAM, which is either
+#   // error: <message>   the compile must fail and report <message>
+#   // output: <text>     the program must succeed and print <text>
+#
+#   cmake -DDEVIANT=<deviant> -DPROGRAM=<file.dv> -P check.cmake
+
+file(STRINGS "${PROGRAM}" expectation LIMIT_COUNT 1)
+execute_process(
+    COMMAND "${DEVIANT}" run "${PROGRAM}"
+    RESULT_VARIABLE status
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors)
+
+if(expectation MATCHES "^// error: (.*)$")
+    set(message "${CMAKE_MATCH_1}")
+    if(status EQUAL 0)
+        message(FATAL_ERROR "compiled although it should not:\n${errors}")
+    endif()
+    string(FIND "${errors}" "Deviant Error: ${message}" found)
+    if(found EQUAL -1)
+        message(FATAL_ERROR "expected the error\n  ${message}\ngot\n${errors}")
+    endif()
+elseif(expectation MATCHES "^// output: (.*)$")
+    set(expected "${CMAKE_MATCH_1}")
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "failed with status ${status}:\n${errors}")
+    endif()
+    if(NOT output STREQUAL expected)
+        message(FATAL_ERROR "expected the output\n  ${expected}\ngot\n  ${output}")
+    endif()
+else()
+    message(FATAL_ERROR "${PROGRAM} starts with neither // error: nor // output:")
+endif()